@@ -3,6 +3,7 @@
 
 #include <string>
 #include <iostream>
+#include <cstddef>
 
 using std::size_t;
 
@@ -10,6 +11,13 @@ using std::size_t;
 
 
 namespace MtmMath {
+
+    /*
+     * Signed 64 bit type of row, column and element indices, so
+     * dimensions and element counts past 2^31 do not wrap
+     */
+    typedef std::ptrdiff_t index_t;
+
     class Dimensions {
         size_t row, col;
     public:
@@ -51,19 +59,19 @@ namespace MtmMath {
             col = prev_row;
         }
 
-        int getRow() const {
-            return (int) row;
+        index_t getRow() const {
+            return (index_t) row;
         }
 
-        int getCol() const {
-            return (int) col;
+        index_t getCol() const {
+            return (index_t) col;
         }
 
-        void setRow(int newRow) {
+        void setRow(index_t newRow) {
             row = (size_t) newRow;
         }
 
-        void setCol(int newColumn) {
+        void setCol(index_t newColumn) {
             col = (size_t) newColumn;
         }
     };
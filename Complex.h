@@ -26,6 +26,14 @@ namespace MtmMath {
             return std::to_string(re) + " " + std::to_string(im) + "i";
         }
 
+        double getReal() const {
+            return re;
+        }
+
+        double getImag() const {
+            return im;
+        }
+
         Complex &operator=(const Complex &c); // assignment operator
         Complex &operator+=(const Complex &c); // this += c
         Complex &operator-=(const Complex &c); // -= c
@@ -37,6 +45,15 @@ namespace MtmMath {
             return *this;
         }
 
+        Complex &operator/=(const Complex &c) {
+            double size = c.re * c.re + c.im * c.im;
+            double real = (re * c.re + im * c.im) / size;
+            double imaginary = (im * c.re - re * c.im) / size;
+            re = real;
+            im = imaginary;
+            return *this;
+        }
+
         Complex operator-() const; // -this
         bool operator==(const Complex &c) const; //  this == c
         bool operator!=(const Complex &c) const;
@@ -46,6 +63,7 @@ namespace MtmMath {
     Complex operator+(const Complex &a, const Complex &b); // a+b
     Complex operator-(const Complex &a, const Complex &b); // a-b
     Complex operator*(const Complex &a, const Complex &b);
+    Complex operator/(const Complex &a, const Complex &b);
 
 
     //Implementations
@@ -81,6 +99,11 @@ namespace MtmMath {
         return c *= b;
     }
 
+    Complex operator/(const Complex &a, const Complex &b) {
+        Complex c = a;
+        return c /= b;
+    }
+
     bool Complex::operator!=(const Complex &c) const {
         return !(operator==(c));
     }
@@ -0,0 +1,265 @@
+#ifndef EX3_MTMASYNC_H
+#define EX3_MTMASYNC_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+#include "MtmMatSq.h"
+#include "MtmLU.h"
+
+namespace MtmMath {
+
+    template<typename R>
+    class Future;
+
+    /*
+     * Runs task() on the scheduler and returns a handle to its result
+     */
+    template<typename F>
+    Future<decltype(std::declval<F>()())>
+    async(F task, MtmScheduler::TaskScheduler &scheduler =
+    MtmScheduler::defaultScheduler());
+
+    /*
+     * Handle to a value computed by a task on the scheduler.
+     * get() on a worker does not block it - it runs other queued tasks
+     * until the value is there; any other thread sleeps until the task
+     * finishes. then() chains a dependent task that is queued
+     * the moment this one finishes, without any thread waiting in between.
+     * Copies of a Future share the same result.
+     */
+    template<typename R>
+    class Future {
+        struct State {
+            std::mutex lock;
+            std::condition_variable finished;
+            std::atomic<bool> ready;
+            std::unique_ptr<R> value;
+            std::exception_ptr error;
+            std::vector<std::function<void()>> continuations;
+
+            State() : ready(false) {}
+        };
+
+        std::shared_ptr<State> state;
+        MtmScheduler::TaskScheduler *scheduler;
+
+        template<typename S>
+        friend class Future;
+
+        template<typename F>
+        friend Future<decltype(std::declval<F>()())>
+        async(F task, MtmScheduler::TaskScheduler &scheduler);
+
+        explicit Future(MtmScheduler::TaskScheduler &scheduler_t)
+                : state(std::make_shared<State>()), scheduler(&scheduler_t) {}
+
+        void finish(std::unique_ptr<R> value, std::exception_ptr error) {
+            std::vector<std::function<void()>> toRun;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                state->value = std::move(value);
+                state->error = error;
+                state->ready = true;
+                toRun.swap(state->continuations);
+            }
+            state->finished.notify_all();
+            for (size_t i = 0; i < toRun.size(); i++) {
+                toRun[i]();
+            }
+        }
+
+        /*
+         * Runs callback once the result is there - right away if it
+         * already is, otherwise from the thread that finishes the task
+         */
+        void whenReady(std::function<void()> callback) const {
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                if (!state->ready) {
+                    state->continuations.push_back(std::move(callback));
+                    return;
+                }
+            }
+            callback();
+        }
+
+        template<typename F>
+        void run(F task) {
+            std::unique_ptr<R> value;
+            std::exception_ptr error;
+            try {
+                value.reset(new R(task()));
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            finish(std::move(value), error);
+        }
+
+    public:
+
+        Future(const Future &toCopy) = default;
+
+        Future &operator=(const Future &c) = default;
+
+        ~Future() = default;
+
+        bool isReady() const {
+            return state->ready;
+        }
+
+        /*
+         * Returns the result, rethrows the exception the task threw
+         */
+        const R &get() const {
+            std::shared_ptr<State> current = state;
+            if (scheduler->isWorkerThread()) {
+                scheduler->helpUntil([current] {
+                    return current->ready.load();
+                });
+            } else {
+                std::unique_lock<std::mutex> guard(current->lock);
+                current->finished.wait(guard, [&current] {
+                    return current->ready.load();
+                });
+            }
+            if (state->error) {
+                std::rethrow_exception(state->error);
+            }
+            return *state->value;
+        }
+
+        /*
+         * Queues f(result) as a new task once this result is ready.
+         * An exception from this task skips f and is passed on.
+         */
+        template<typename F>
+        Future<decltype(std::declval<F>()(std::declval<const R &>()))>
+        then(F f) const {
+            typedef decltype(std::declval<F>()(std::declval<const R &>()))
+                    Next;
+            Future<Next> next(*scheduler);
+            std::shared_ptr<State> current = state;
+            MtmScheduler::TaskScheduler *pool = scheduler;
+            whenReady([current, next, f, pool] {
+                pool->submit([current, next, f] {
+                    Future<Next> target = next;
+                    if (current->error) {
+                        target.finish(std::unique_ptr<Next>(),
+                                      current->error);
+                        return;
+                    }
+                    target.run([&current, &f] { return f(*current->value); });
+                });
+            });
+            return next;
+        }
+
+        /*
+         * Queues f(result, otherResult) once both results are ready
+         */
+        template<typename S, typename F>
+        Future<decltype(std::declval<F>()(std::declval<const R &>(),
+                                          std::declval<const S &>()))>
+        thenWith(const Future<S> &other, F f) const {
+            typedef decltype(std::declval<F>()(std::declval<const R &>(),
+                                               std::declval<const S &>()))
+                    Next;
+            Future<Next> next(*scheduler);
+            std::shared_ptr<State> first = state;
+            Future<S> second = other;
+            MtmScheduler::TaskScheduler *pool = scheduler;
+            whenReady([first, second, next, f, pool] {
+                second.whenReady([first, second, next, f, pool] {
+                    pool->submit([first, second, next, f] {
+                        Future<Next> target = next;
+                        std::exception_ptr error = first->error ?
+                                                   first->error :
+                                                   second.state->error;
+                        if (error) {
+                            target.finish(std::unique_ptr<Next>(), error);
+                            return;
+                        }
+                        target.run([&first, &second, &f] {
+                            return f(*first->value, *second.state->value);
+                        });
+                    });
+                });
+            });
+            return next;
+        }
+    };
+
+    template<typename F>
+    Future<decltype(std::declval<F>()())>
+    async(F task, MtmScheduler::TaskScheduler &scheduler) {
+        typedef decltype(std::declval<F>()()) R;
+        Future<R> result(scheduler);
+        scheduler.submit([result, task] {
+            Future<R> target = result;
+            target.run(task);
+        });
+        return result;
+    }
+
+    //ASYNC MATRIX OPERATIONS - operands are copied into the task
+
+    template<typename T>
+    Future<MtmMat<T>> multiplyAsync(const MtmMat<T> &a, const MtmMat<T> &b) {
+        MtmMat<T> left = a;
+        MtmMat<T> right = b;
+        return async([left, right] { return MtmMat<T>(left * right); });
+    }
+
+    template<typename T>
+    Future<MtmMat<T>> multiplyAsync(const Future<MtmMat<T>> &a,
+                                    const Future<MtmMat<T>> &b) {
+        return a.thenWith(b, [](const MtmMat<T> &left,
+                                const MtmMat<T> &right) {
+            return MtmMat<T>(left * right);
+        });
+    }
+
+    template<typename T>
+    Future<MtmMat<T>> transposeAsync(const MtmMat<T> &a) {
+        MtmMat<T> source = a;
+        return async([source] {
+            MtmMat<T> result = source;
+            result.transpose();
+            return result;
+        });
+    }
+
+    template<typename T>
+    Future<MtmMat<T>> transposeAsync(const Future<MtmMat<T>> &a) {
+        return a.then([](const MtmMat<T> &source) {
+            MtmMat<T> result = source;
+            result.transpose();
+            return result;
+        });
+    }
+
+    template<typename T>
+    Future<LUDecomposition<T>> luAsync(const MtmMatSq<T> &a) {
+        MtmMatSq<T> source = a;
+        return async([source] { return LUDecomposition<T>(source); });
+    }
+
+    template<typename T>
+    Future<LUDecomposition<T>> luAsync(const Future<MtmMat<T>> &a) {
+        return a.then([](const MtmMat<T> &source) {
+            return LUDecomposition<T>(MtmMatSq<T>(source));
+        });
+    }
+
+}
+
+#endif //EX3_MTMASYNC_H
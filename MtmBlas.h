@@ -0,0 +1,242 @@
+#ifndef EX3_MTMBLAS_H
+#define EX3_MTMBLAS_H
+
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmKernels.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+/*
+ * BLAS style kernels that write into caller provided outputs.
+ * Dimensions are validated once per call and nothing is allocated, so
+ * they can run inside hot loops. Outputs must not alias the inputs.
+ */
+
+namespace MtmMath {
+    namespace MtmBlas {
+
+        enum Transpose {
+            NO_TRANS,
+            TRANS
+        };
+
+        /*
+         * y = a * x + y, x and y need the same dimensions
+         */
+        template<typename T>
+        void axpy(const T &a, const MtmVec<T> &x, MtmVec<T> &y) {
+            if (x.getDimensions() != y.getDimensions()) {
+                throw MtmExceptions::DimensionMismatch(x.getDimensions(),
+                                                       y.getDimensions());
+            }
+            MTM_STATS_OPERATION(BLAS_AXPY, 2 * x.size());
+
+            //a may be one of the elements of y, copied like BLAS alpha
+            const T scale = a;
+            const T *in = x.data();
+            T *out = y.data();
+            size_t n = x.size();
+            MtmCpu::dispatchFor<T>([in, out, n, scale] {
+                for (size_t i = 0; i < n; i++) {
+                    out[i] += scale * in[i];
+                }
+            });
+        }
+
+        /*
+         * x = a * x
+         */
+        template<typename T>
+        void scal(const T &a, MtmVec<T> &x) {
+            MTM_STATS_OPERATION(BLAS_SCAL, x.size());
+
+            //a may be one of the elements of x
+            const T scale = a;
+            T *out = x.data();
+            size_t n = x.size();
+            MtmCpu::dispatchFor<T>([out, n, scale] {
+                for (size_t i = 0; i < n; i++) {
+                    out[i] *= scale;
+                }
+            });
+        }
+
+        /*
+         * y = alpha * op(A) * x + beta * y, where op(A) is A or A^T.
+         * x and y can be row or column vectors, only their lengths have to
+         * match op(A).
+         */
+        template<typename T>
+        void gemv(const T &alpha, const MtmMat<T> &a, Transpose transA,
+                  const MtmVec<T> &x, const T &beta, MtmVec<T> &y) {
+            size_t rows = (size_t) a.getDimensions().getRow();
+            size_t cols = (size_t) a.getDimensions().getCol();
+            size_t opRows = transA == TRANS ? cols : rows;
+            size_t opCols = transA == TRANS ? rows : cols;
+            if (x.size() != opCols) {
+                throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                       x.getDimensions());
+            }
+            if (y.size() != opRows) {
+                throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                       y.getDimensions());
+            }
+            MTM_STATS_OPERATION(BLAS_GEMV, 2 * rows * cols);
+
+            const T *in = x.data();
+            T *out = y.data();
+            if (transA == NO_TRANS) {
+                for (size_t i = 0; i < rows; i++) {
+                    T sum = MtmKernels::dot(a[(index_t) i].data(), in, cols);
+                    out[i] = (beta == T()) ? alpha * sum :
+                             alpha * sum + beta * out[i];
+                }
+                return;
+            }
+
+            MtmKernels::scaleRows(1, opRows, beta,
+                                  MtmKernels::ContiguousRows<T>(out, 0));
+            MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+            MtmCpu::dispatchFor<T>([aRow, in, out, rows, cols, alpha] {
+                for (size_t i = 0; i < rows; i++) {
+                    const T *row = aRow(i);
+                    const T scale = alpha * in[i];
+                    for (size_t j = 0; j < cols; j++) {
+                        out[j] += scale * row[j];
+                    }
+                }
+            });
+        }
+
+        /*
+         * C = alpha * op(A) * op(B) + beta * C, where op(X) is X or X^T.
+         * C has to be allocated with the dimensions of the product.
+         */
+        template<typename T>
+        void gemm(const T &alpha, const MtmMat<T> &a, Transpose transA,
+                  const MtmMat<T> &b, Transpose transB, const T &beta,
+                  MtmMat<T> &c) {
+            Dimensions opA = a.getDimensions();
+            Dimensions opB = b.getDimensions();
+            if (transA == TRANS) {
+                opA.transpose();
+            }
+            if (transB == TRANS) {
+                opB.transpose();
+            }
+            if (opA.getCol() != opB.getRow()) {
+                throw MtmExceptions::DimensionMismatch(opA, opB);
+            }
+            if (c.getDimensions() != Dimensions((size_t) opA.getRow(),
+                                                (size_t) opB.getCol())) {
+                throw MtmExceptions::DimensionMismatch(
+                        Dimensions((size_t) opA.getRow(),
+                                   (size_t) opB.getCol()),
+                        c.getDimensions());
+            }
+
+            size_t m = (size_t) opA.getRow();
+            size_t n = (size_t) opB.getCol();
+            size_t k = (size_t) opA.getCol();
+            MTM_STATS_OPERATION(BLAS_GEMM, 2 * m * n * k);
+
+            MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+            MtmKernels::MatRows<const MtmMat<T>, const T> bRow(b);
+            MtmKernels::MatRows<MtmMat<T>, T> cRow(c);
+            MtmKernels::scaleRows(m, n, beta, cRow);
+            if (alpha == T()) {
+                return;
+            }
+
+            if (transA == NO_TRANS && transB == NO_TRANS) {
+                MtmKernels::gemmBlocked<T>(m, n, k, alpha, aRow, bRow, cRow);
+            } else if (transA == TRANS && transB == NO_TRANS) {
+                MtmKernels::gemmTransA<T>(m, n, k, alpha, aRow, bRow, cRow);
+            } else if (transA == NO_TRANS) {
+                MtmKernels::gemmTransB<T>(m, n, k, alpha, aRow, bRow, cRow);
+            } else {
+                MtmKernels::gemmTransAB<T>(m, n, k, alpha, aRow, bRow, cRow);
+            }
+        }
+
+        /*
+         * A = alpha * x * y^T + A (rank-1 update), x has A's row count and
+         * y its column count, either can be a row or a column vector
+         */
+        template<typename T>
+        void ger(const T &alpha, const MtmVec<T> &x, const MtmVec<T> &y,
+                 MtmMat<T> &a) {
+            size_t rows = (size_t) a.getDimensions().getRow();
+            size_t cols = (size_t) a.getDimensions().getCol();
+            if (x.size() != rows) {
+                throw MtmExceptions::DimensionMismatch(x.getDimensions(),
+                                                       a.getDimensions());
+            }
+            if (y.size() != cols) {
+                throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                       y.getDimensions());
+            }
+            MTM_STATS_OPERATION(BLAS_GER, 2 * rows * cols);
+
+            const T *in = y.data();
+            for (size_t i = 0; i < rows; i++) {
+                const T scale = alpha * x.data()[i];
+                if (scale == T()) {
+                    continue;
+                }
+                T *row = a[(index_t) i].data();
+                for (size_t j = 0; j < cols; j++) {
+                    row[j] += scale * in[j];
+                }
+            }
+        }
+
+        /*
+         * A = alpha * U * V^T + A (rank-k update) for U m x k and V n x k,
+         * so column p of U and V is the p-th pair of an outer product.
+         * Every element is a length k dot product of two rows.
+         */
+        template<typename T>
+        void gerk(const T &alpha, const MtmMat<T> &u, const MtmMat<T> &v,
+                  MtmMat<T> &a) {
+            gemm(alpha, u, NO_TRANS, v, TRANS, T(1), a);
+        }
+
+        /*
+         * C = alpha * U * U^T + beta * C for a symmetric C and U n x k.
+         * Only the lower triangle is computed and then mirrored over the
+         * upper one, half the work of gemm.
+         */
+        template<typename T>
+        void syrk(const T &alpha, const MtmMat<T> &u, const T &beta,
+                  MtmMat<T> &c) {
+            size_t n = (size_t) u.getDimensions().getRow();
+            size_t k = (size_t) u.getDimensions().getCol();
+            if (c.getDimensions() != Dimensions(n, n)) {
+                throw MtmExceptions::DimensionMismatch(Dimensions(n, n),
+                                                       c.getDimensions());
+            }
+            MTM_STATS_OPERATION(BLAS_SYRK, n * (n + 1) * k);
+
+            for (size_t i = 0; i < n; i++) {
+                const T *ui = u[(index_t) i].data();
+                T *row = c[(index_t) i].data();
+                for (size_t j = 0; j <= i; j++) {
+                    T sum = alpha * MtmKernels::dot(ui, u[(index_t) j].data(), k);
+                    row[j] = (beta == T()) ? sum : sum + beta * row[j];
+                }
+            }
+            for (size_t i = 0; i < n; i++) {
+                T *row = c[(index_t) i].data();
+                for (size_t j = i + 1; j < n; j++) {
+                    row[j] = c[(index_t) j].data()[i];
+                }
+            }
+        }
+
+    }
+}
+
+#endif //EX3_MTMBLAS_H
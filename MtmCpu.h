@@ -0,0 +1,217 @@
+#ifndef EX3_MTMCPU_H
+#define EX3_MTMCPU_H
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * Runtime selection of the instruction set the numeric kernels run with,
+ * so one binary built for baseline x86-64 still uses AVX2 / AVX-512 on
+ * hosts that have them.
+ * The level is read once from CPUID. MTM_ISA=generic|sse4.2|avx2|avx512
+ * in the environment lowers it (a level the cpu lacks is never chosen),
+ * setIsaLevel() does the same from code.
+ * dispatch(body) runs body through a trampoline built with the target
+ * attribute of the selected level and flatten, so the whole kernel body
+ * is inlined into it and compiled (vectorized) for that level. Kernels
+ * keep one portable source, no intrinsics are needed.
+ * Define MTM_NO_DISPATCH, or build for anything but x86 with GCC/Clang,
+ * to always run the kernels as compiled.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+    !defined(MTM_NO_DISPATCH)
+#define MTM_CPU_DISPATCH 1
+#define MTM_TARGET(isa) __attribute__((target(isa)))
+#if defined(__clang__)
+#define MTM_TARGET_FLATTEN(isa) __attribute__((target(isa), flatten))
+#else
+//GCC only vectorizes loops with runtime alias checks from -O3 on
+#define MTM_TARGET_FLATTEN(isa) __attribute__((target(isa), flatten, \
+        optimize("tree-vectorize", "vect-cost-model=dynamic")))
+#endif
+#else
+#define MTM_TARGET(isa)
+#define MTM_TARGET_FLATTEN(isa)
+#endif
+
+#define MTM_ISA_SSE42 "sse4.2,popcnt"
+#define MTM_ISA_AVX2 "avx2,fma,bmi,bmi2"
+#define MTM_ISA_AVX512 "avx512f,avx512vl,avx512bw,avx512dq,avx2,fma,bmi,bmi2"
+
+namespace MtmMath {
+
+    class Complex;
+
+    namespace MtmCpu {
+
+        /*
+         * Element types whose kernels are compiled per level: numbers and
+         * Complex (two doubles, vectorizes like them). Types with costly
+         * element arithmetic (ModInt, ...) keep the default and run as
+         * compiled; specialize this to opt a type in.
+         */
+        template<typename T>
+        struct Vectorized : std::is_arithmetic<T> {
+        };
+
+        template<>
+        struct Vectorized<Complex> : std::true_type {
+        };
+
+        enum IsaLevel {
+            ISA_GENERIC,
+            ISA_SSE42,
+            ISA_AVX2,
+            ISA_AVX512
+        };
+
+        inline const char *isaName(IsaLevel level) {
+            static const char *names[] = {"generic", "sse4.2", "avx2",
+                                          "avx512"};
+            return names[level];
+        }
+
+        /*
+         * Highest level the cpu (and the os, for the wide registers)
+         * supports
+         */
+        inline IsaLevel detectIsa() {
+#ifdef MTM_CPU_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") &&
+                __builtin_cpu_supports("avx512vl") &&
+                __builtin_cpu_supports("avx512bw") &&
+                __builtin_cpu_supports("avx512dq") &&
+                __builtin_cpu_supports("avx2") &&
+                __builtin_cpu_supports("fma")) {
+                return ISA_AVX512;
+            }
+            if (__builtin_cpu_supports("avx2") &&
+                __builtin_cpu_supports("fma") &&
+                __builtin_cpu_supports("bmi2")) {
+                return ISA_AVX2;
+            }
+            if (__builtin_cpu_supports("sse4.2") &&
+                __builtin_cpu_supports("popcnt")) {
+                return ISA_SSE42;
+            }
+#endif
+            return ISA_GENERIC;
+        }
+
+        namespace MtmCpuOps {
+
+            /*
+             * Level named by MTM_ISA, or fallback when it is unset or
+             * not recognized
+             */
+            inline IsaLevel environmentIsa(IsaLevel fallback) {
+                const char *name = std::getenv("MTM_ISA");
+                if (name == nullptr) {
+                    return fallback;
+                }
+                for (int level = ISA_GENERIC; level <= ISA_AVX512; level++) {
+                    if (std::strcmp(name, isaName((IsaLevel) level)) == 0) {
+                        return (IsaLevel) level;
+                    }
+                }
+                return fallback;
+            }
+
+            inline std::atomic<int> &isaStorage() {
+                static std::atomic<int> level([] {
+                    IsaLevel detected = detectIsa();
+                    IsaLevel wanted = environmentIsa(detected);
+                    return (int) (wanted < detected ? wanted : detected);
+                }());
+                return level;
+            }
+
+            template<typename Body>
+            MTM_TARGET_FLATTEN(MTM_ISA_AVX512)
+            void runAvx512(Body &body) {
+                body();
+            }
+
+            template<typename Body>
+            MTM_TARGET_FLATTEN(MTM_ISA_AVX2)
+            void runAvx2(Body &body) {
+                body();
+            }
+
+            template<typename Body>
+            MTM_TARGET_FLATTEN(MTM_ISA_SSE42)
+            void runSse42(Body &body) {
+                body();
+            }
+
+            template<typename Body>
+            void dispatch(Body &body, std::true_type) {
+#ifdef MTM_CPU_DISPATCH
+                switch ((IsaLevel) isaStorage().load(
+                        std::memory_order_relaxed)) {
+                    case ISA_AVX512:
+                        runAvx512(body);
+                        return;
+                    case ISA_AVX2:
+                        runAvx2(body);
+                        return;
+                    case ISA_SSE42:
+                        runSse42(body);
+                        return;
+                    default:
+                        break;
+                }
+#endif
+                body();
+            }
+
+            template<typename Body>
+            void dispatch(Body &body, std::false_type) {
+                body();
+            }
+        }
+
+        /*
+         * Level the kernels currently run with
+         */
+        inline IsaLevel isaLevel() {
+            return (IsaLevel) MtmCpuOps::isaStorage().load();
+        }
+
+        /*
+         * Runs the kernels with level, or the highest supported level
+         * below it. Returns the level actually selected. Meant for tests
+         * and benchmarks, kernels already running keep their level.
+         */
+        inline IsaLevel setIsaLevel(IsaLevel level) {
+            IsaLevel detected = detectIsa();
+            IsaLevel selected = level < detected ? level : detected;
+            MtmCpuOps::isaStorage() = (int) selected;
+            return selected;
+        }
+
+        /*
+         * body() compiled for the selected level
+         */
+        template<typename Body>
+        void dispatch(Body body) {
+            MtmCpuOps::dispatch(body, std::true_type());
+        }
+
+        /*
+         * dispatch for kernels over elements of type T. Only Vectorized
+         * types gain from wider vectors, everything else runs body() once
+         * as compiled instead of being instantiated per level.
+         */
+        template<typename T, typename Body>
+        void dispatchFor(Body body) {
+            MtmCpuOps::dispatch(body, Vectorized<T>());
+        }
+    }
+}
+
+#endif //EX3_MTMCPU_H
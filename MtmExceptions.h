@@ -89,6 +89,29 @@ namespace MtmMath {
                 return "MtmError: Attempt access to illegal element";
             }
         };
+
+        /*
+         * Exception for a zero pivot while factorizing or solving a system,
+         * needs to output "MtmError: Singular matrix" in what() class function
+         */
+        class SingularMatrix : public MtmExceptions {
+        public:
+            const char *what() const throw() override {
+                return "MtmError: Singular matrix";
+            }
+        };
+
+        /*
+         * Exception for a truncated or corrupt serialized matrix/vector,
+         * needs to output "MtmError: Malformed stream" in what() class
+         * function
+         */
+        class MalformedStream : public MtmExceptions {
+        public:
+            const char *what() const throw() override {
+                return "MtmError: Malformed stream";
+            }
+        };
     }
 }
 
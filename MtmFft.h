@@ -0,0 +1,737 @@
+#ifndef EX3_MTMFFT_H
+#define EX3_MTMFFT_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "Complex.h"
+#include "MtmScheduler.h"
+#include "MtmStats.h"
+#include "MtmCpu.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+/*
+ * Discrete Fourier transforms on MtmVec<Complex> / MtmMat<Complex>,
+ * working on the Complex storage directly.
+ * X[k] = sum over j of x[j] * e^(-2 pi i j k / n), the inverse divides
+ * by n.
+ * Lengths whose prime factors are all at most FFT_MAX_RADIX run as a
+ * mixed radix Stockham FFT (radix 4, 2, 3 butterflies and a generic one
+ * for larger primes), any other length through Bluestein's algorithm on
+ * a power of two, so every length is O(n log n).
+ * Plans (factorization and twiddle tables) are built once per length and
+ * kept in a process wide cache, plans are read only and shared between
+ * threads.
+ */
+
+namespace MtmMath {
+
+    //largest prime handled by a butterfly, lengths with a bigger prime
+    //factor use Bluestein
+    const size_t FFT_MAX_RADIX = 31;
+
+    //below this many multiply-adds convolve/correlate stay direct
+    const size_t CONVOLVE_DIRECT_THRESHOLD = 1 << 12;
+
+    enum FftDirection {
+        FFT_FORWARD,
+        FFT_INVERSE
+    };
+
+    namespace MtmFftOps {
+
+        const double PI = 3.14159265358979323846;
+
+        inline Complex add(const Complex &a, const Complex &b) {
+            return Complex(a.getReal() + b.getReal(),
+                           a.getImag() + b.getImag());
+        }
+
+        inline Complex sub(const Complex &a, const Complex &b) {
+            return Complex(a.getReal() - b.getReal(),
+                           a.getImag() - b.getImag());
+        }
+
+        inline Complex mul(const Complex &a, const Complex &b) {
+            return Complex(a.getReal() * b.getReal() -
+                           a.getImag() * b.getImag(),
+                           a.getReal() * b.getImag() +
+                           a.getImag() * b.getReal());
+        }
+
+        inline Complex scale(const Complex &a, double s) {
+            return Complex(a.getReal() * s, a.getImag() * s);
+        }
+
+        inline Complex conj(const Complex &a) {
+            return Complex(a.getReal(), -a.getImag());
+        }
+
+        //-i * a
+        inline Complex rotate(const Complex &a) {
+            return Complex(a.getImag(), -a.getReal());
+        }
+
+        //e^(-2 pi i numerator / denominator)
+        inline Complex root(size_t numerator, size_t denominator) {
+            double angle = -2 * PI * (double) (numerator % denominator) /
+                           (double) denominator;
+            return Complex(std::cos(angle), std::sin(angle));
+        }
+
+        inline size_t nextPowerOfTwo(size_t n) {
+            size_t result = 1;
+            while (result < n) {
+                result <<= 1;
+            }
+            return result;
+        }
+    }
+
+    /*
+     * Forward transform of one length. execute() needs scratchSize()
+     * elements of scratch and distinct in, out and scratch arrays.
+     */
+    class FftPlan {
+        /*
+         * One Stockham pass of radix `radix` over sub-transforms of
+         * length span (the product of the earlier radices)
+         */
+        struct Stage {
+            size_t radix;
+            size_t span;
+            std::vector<Complex> twiddles; //[k * (radix - 1) + t - 1]
+            std::vector<Complex> roots; //generic butterflies only
+        };
+
+        size_t n;
+        std::vector<Stage> stages;
+        //Bluestein: chirp, transformed kernel and the power of two plan
+        std::vector<Complex> chirp;
+        std::vector<Complex> kernel;
+        std::shared_ptr<const FftPlan> inner;
+
+        static void butterfly(const Stage &stage, Complex *v);
+
+        void runStage(const Stage &stage, const Complex *src,
+                      Complex *dst) const;
+
+        void stockham(const Complex *in, Complex *out,
+                      Complex *scratch) const;
+
+        void bluestein(const Complex *in, Complex *out,
+                       Complex *scratch) const;
+
+    public:
+        explicit FftPlan(size_t n_t);
+
+        size_t size() const {
+            return n;
+        }
+
+        size_t scratchSize() const {
+            return inner ? 2 * inner->size() + inner->scratchSize() : n;
+        }
+
+        void execute(const Complex *in, Complex *out,
+                     Complex *scratch) const {
+            MtmCpu::dispatch([this, in, out, scratch] {
+                if (inner) {
+                    bluestein(in, out, scratch);
+                } else {
+                    stockham(in, out, scratch);
+                }
+            });
+        }
+
+        /*
+         * out = unnormalized inverse transform (n times the true inverse)
+         */
+        void executeInverse(const Complex *in, Complex *out,
+                            Complex *scratch) const {
+            Complex *flipped = scratch;
+            for (size_t i = 0; i < n; i++) {
+                flipped[i] = MtmFftOps::conj(in[i]);
+            }
+            execute(flipped, out, scratch + n);
+            for (size_t i = 0; i < n; i++) {
+                out[i] = MtmFftOps::conj(out[i]);
+            }
+        }
+
+        size_t inverseScratchSize() const {
+            return n + scratchSize();
+        }
+    };
+
+    /*
+     * Shared plan for length n out of the process wide cache
+     */
+    inline std::shared_ptr<const FftPlan> fftPlan(size_t n) {
+        static std::mutex lock;
+        static std::map<size_t, std::shared_ptr<const FftPlan>> cache;
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = cache.find(n);
+        if (found != cache.end()) {
+            return found->second;
+        }
+        std::shared_ptr<const FftPlan> plan;
+        try {
+            plan = std::make_shared<const FftPlan>(n);
+        }
+        catch (std::bad_alloc &e) {
+            throw MtmExceptions::OutOfMemory();
+        }
+        cache[n] = plan;
+        return plan;
+    }
+
+    inline FftPlan::FftPlan(size_t n_t) : n(n_t) {
+        if (n == 0) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        std::vector<size_t> radices;
+        size_t rest = n;
+        while (rest % 4 == 0) {
+            radices.push_back(4);
+            rest /= 4;
+        }
+        for (size_t p = 2; p <= FFT_MAX_RADIX && rest > 1; p++) {
+            while (rest % p == 0) {
+                radices.push_back(p);
+                rest /= p;
+            }
+        }
+        if (rest > 1) {
+            //chirp uses k^2 mod 2n so the angles stay exact for big k
+            size_t m = MtmFftOps::nextPowerOfTwo(2 * n - 1);
+            inner = (std::shared_ptr<const FftPlan>) std::make_shared<
+                    const FftPlan>(m);
+            chirp.resize(n);
+            for (size_t k = 0; k < n; k++) {
+                chirp[k] = MtmFftOps::root((k * k) % (2 * n), 2 * n);
+            }
+            std::vector<Complex> b(m, Complex());
+            b[0] = MtmFftOps::conj(chirp[0]);
+            for (size_t k = 1; k < n; k++) {
+                b[k] = b[m - k] = MtmFftOps::conj(chirp[k]);
+            }
+            kernel.resize(m);
+            std::vector<Complex> scratch(inner->scratchSize());
+            inner->execute(b.data(), kernel.data(), scratch.data());
+            return;
+        }
+
+        size_t span = 1;
+        for (size_t r : radices) {
+            Stage stage;
+            stage.radix = r;
+            stage.span = span;
+            stage.twiddles.resize(span * (r - 1));
+            for (size_t k = 0; k < span; k++) {
+                for (size_t t = 1; t < r; t++) {
+                    stage.twiddles[k * (r - 1) + t - 1] =
+                            MtmFftOps::root(t * k, span * r);
+                }
+            }
+            if (r > 4) {
+                stage.roots.resize(r);
+                for (size_t t = 0; t < r; t++) {
+                    stage.roots[t] = MtmFftOps::root(t, r);
+                }
+            }
+            stages.push_back(stage);
+            span *= r;
+        }
+    }
+
+    inline void FftPlan::butterfly(const Stage &stage, Complex *v) {
+        using namespace MtmFftOps;
+        switch (stage.radix) {
+            case 2: {
+                Complex a = v[0];
+                v[0] = add(a, v[1]);
+                v[1] = sub(a, v[1]);
+                return;
+            }
+            case 3: {
+                const double s = 0.86602540378443864676; //sin(2 pi / 3)
+                Complex sum = add(v[1], v[2]);
+                Complex half = sub(v[0], scale(sum, 0.5));
+                Complex turn = scale(rotate(sub(v[1], v[2])), s);
+                v[0] = add(v[0], sum);
+                v[1] = add(half, turn);
+                v[2] = sub(half, turn);
+                return;
+            }
+            case 4: {
+                Complex even0 = add(v[0], v[2]);
+                Complex even1 = sub(v[0], v[2]);
+                Complex odd0 = add(v[1], v[3]);
+                Complex odd1 = rotate(sub(v[1], v[3]));
+                v[0] = add(even0, odd0);
+                v[1] = add(even1, odd1);
+                v[2] = sub(even0, odd0);
+                v[3] = sub(even1, odd1);
+                return;
+            }
+            default: {
+                Complex in[FFT_MAX_RADIX];
+                std::copy(v, v + stage.radix, in);
+                for (size_t k = 0; k < stage.radix; k++) {
+                    Complex sum = in[0];
+                    for (size_t t = 1; t < stage.radix; t++) {
+                        sum = add(sum, mul(in[t],
+                                           stage.roots[(t * k) %
+                                                       stage.radix]));
+                    }
+                    v[k] = sum;
+                }
+            }
+        }
+    }
+
+    inline void FftPlan::runStage(const Stage &stage, const Complex *src,
+                                  Complex *dst) const {
+        const size_t r = stage.radix;
+        const size_t span = stage.span;
+        const size_t stride = n / r;
+        Complex v[FFT_MAX_RADIX];
+        for (size_t group = 0; group < stride; group += span) {
+            Complex *out = dst + group * r;
+            for (size_t k = 0; k < span; k++) {
+                const Complex *in = src + group + k;
+                const Complex *twiddle = stage.twiddles.data() + k * (r - 1);
+                v[0] = in[0];
+                for (size_t t = 1; t < r; t++) {
+                    v[t] = MtmFftOps::mul(in[t * stride], twiddle[t - 1]);
+                }
+                butterfly(stage, v);
+                for (size_t t = 0; t < r; t++) {
+                    out[k + t * span] = v[t];
+                }
+            }
+        }
+    }
+
+    inline void FftPlan::stockham(const Complex *in, Complex *out,
+                                  Complex *scratch) const {
+        if (stages.empty()) {
+            out[0] = in[0];
+            return;
+        }
+        //pick the first target so that the last pass lands in out
+        const Complex *src = in;
+        Complex *dst = (stages.size() % 2) ? out : scratch;
+        for (size_t s = 0; s < stages.size(); s++) {
+            runStage(stages[s], src, dst);
+            src = dst;
+            dst = (dst == out) ? scratch : out;
+        }
+    }
+
+    inline void FftPlan::bluestein(const Complex *in, Complex *out,
+                                   Complex *scratch) const {
+        using namespace MtmFftOps;
+        const size_t m = inner->size();
+        Complex *a = scratch;
+        Complex *transformed = scratch + m;
+        Complex *innerScratch = scratch + 2 * m;
+        for (size_t k = 0; k < n; k++) {
+            a[k] = mul(in[k], chirp[k]);
+        }
+        std::fill(a + n, a + m, Complex());
+        inner->execute(a, transformed, innerScratch);
+        for (size_t k = 0; k < m; k++) {
+            a[k] = conj(mul(transformed[k], kernel[k]));
+        }
+        inner->execute(a, transformed, innerScratch);
+        const double norm = 1.0 / (double) m;
+        for (size_t k = 0; k < n; k++) {
+            out[k] = mul(scale(conj(transformed[k]), norm), chirp[k]);
+        }
+    }
+
+    namespace MtmFftOps {
+
+        /*
+         * Plan and twiddles e^(-2 pi i k / n), k <= n / 2, for a real
+         * transform of even length n done as a complex one of n / 2
+         */
+        struct RealPlan {
+            std::shared_ptr<const FftPlan> half;
+            std::vector<Complex> twiddles;
+        };
+
+        inline std::shared_ptr<const RealPlan> realPlan(size_t n) {
+            static std::mutex lock;
+            static std::map<size_t, std::shared_ptr<const RealPlan>> cache;
+            std::shared_ptr<const FftPlan> half = fftPlan(n / 2);
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = cache.find(n);
+            if (found != cache.end()) {
+                return found->second;
+            }
+            std::shared_ptr<RealPlan> plan = std::make_shared<RealPlan>();
+            plan->half = half;
+            plan->twiddles.resize(n / 2 + 1);
+            for (size_t k = 0; k <= n / 2; k++) {
+                plan->twiddles[k] = root(k, n);
+            }
+            cache[n] = plan;
+            return plan;
+        }
+
+        /*
+         * out[0..n/2] = transform of n real values
+         */
+        inline void realForward(const double *in, size_t n, Complex *out) {
+            if (n % 2 != 0) {
+                std::shared_ptr<const FftPlan> plan = fftPlan(n);
+                std::vector<Complex> buffer(2 * n + plan->scratchSize());
+                for (size_t i = 0; i < n; i++) {
+                    buffer[i] = Complex(in[i], 0);
+                }
+                plan->execute(buffer.data(), buffer.data() + n,
+                              buffer.data() + 2 * n);
+                std::copy(buffer.data() + n, buffer.data() + n + n / 2 + 1,
+                          out);
+                return;
+            }
+            size_t h = n / 2;
+            std::shared_ptr<const RealPlan> plan = realPlan(n);
+            std::vector<Complex> buffer(2 * h + plan->half->scratchSize());
+            Complex *packed = buffer.data();
+            Complex *z = packed + h;
+            for (size_t i = 0; i < h; i++) {
+                packed[i] = Complex(in[2 * i], in[2 * i + 1]);
+            }
+            plan->half->execute(packed, z, z + h);
+            for (size_t k = 0; k <= h; k++) {
+                Complex zk = z[k % h];
+                Complex zr = conj(z[(h - k) % h]);
+                Complex even = scale(add(zk, zr), 0.5);
+                Complex odd = scale(rotate(sub(zk, zr)), 0.5);
+                out[k] = add(even, mul(plan->twiddles[k], odd));
+            }
+        }
+
+        /*
+         * out[0..n) = unnormalized inverse of the half spectrum in[0..n/2]
+         */
+        inline void realInverse(const Complex *in, size_t n, double *out) {
+            if (n % 2 != 0) {
+                std::shared_ptr<const FftPlan> plan = fftPlan(n);
+                std::vector<Complex> buffer(2 * n +
+                                            plan->inverseScratchSize());
+                for (size_t k = 0; k <= n / 2; k++) {
+                    buffer[k] = in[k];
+                }
+                for (size_t k = n / 2 + 1; k < n; k++) {
+                    buffer[k] = conj(in[n - k]);
+                }
+                plan->executeInverse(buffer.data(), buffer.data() + n,
+                                     buffer.data() + 2 * n);
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = buffer[n + i].getReal();
+                }
+                return;
+            }
+            size_t h = n / 2;
+            std::shared_ptr<const RealPlan> plan = realPlan(n);
+            std::vector<Complex> buffer(2 * h +
+                                        plan->half->inverseScratchSize());
+            Complex *packed = buffer.data();
+            Complex *z = packed + h;
+            for (size_t k = 0; k < h; k++) {
+                Complex xk = in[k];
+                Complex xr = conj(in[h - k]);
+                Complex even = add(xk, xr);
+                Complex odd = mul(sub(xk, xr), conj(plan->twiddles[k]));
+                //even + i * odd, i * odd = -rotate(odd)
+                packed[k] = sub(even, rotate(odd));
+            }
+            plan->half->executeInverse(packed, z, z + h);
+            for (size_t i = 0; i < h; i++) {
+                out[2 * i] = z[i].getReal();
+                out[2 * i + 1] = z[i].getImag();
+            }
+        }
+
+        /*
+         * Smallest 2^a * 3^b * 5^c >= n, lengths the Stockham passes
+         * handle fastest. even keeps a >= 1 for the real transforms,
+         * which run a complex one of half the length.
+         */
+        inline size_t fastLength(size_t n, bool even = false) {
+            size_t best = std::max(nextPowerOfTwo(n), (size_t) (even ? 2 : 1));
+            for (size_t p5 = 1; p5 < best; p5 *= 5) {
+                for (size_t p35 = p5; p35 < best; p35 *= 3) {
+                    size_t candidate = even ? 2 * p35 : p35;
+                    while (candidate < n) {
+                        candidate *= 2;
+                    }
+                    best = std::min(best, candidate);
+                }
+            }
+            return best;
+        }
+
+        template<typename T>
+        MtmVec<T> vectorLike(size_t n, const MtmVec<T> &shape) {
+            MtmVec<T> result = MtmVec<T>(n, T());
+            if (shape.getDimensions().getRow() == 1 &&
+                shape.getDimensions().getCol() != 1) {
+                result.transpose();
+            }
+            return result;
+        }
+
+        inline void transformArray(const FftPlan &plan, FftDirection direction,
+                                   const Complex *in, Complex *out,
+                                   Complex *scratch) {
+            MTM_STATS_OPERATION(FFT_TRANSFORM,
+                                5 * plan.size() *
+                                (size_t) std::log2((double) plan.size() + 1));
+            if (direction == FFT_FORWARD) {
+                plan.execute(in, out, scratch);
+                return;
+            }
+            plan.executeInverse(in, out, scratch);
+            const double norm = 1.0 / (double) plan.size();
+            for (size_t i = 0; i < plan.size(); i++) {
+                out[i] = scale(out[i], norm);
+            }
+        }
+
+        inline double conjugate(double x) {
+            return x;
+        }
+
+        inline Complex conjugate(const Complex &x) {
+            return conj(x);
+        }
+
+        template<typename T>
+        MtmVec<T> convolveDirect(const T *a, size_t na, const T *b,
+                                 size_t nb, const MtmVec<T> &shape) {
+            MtmVec<T> result = vectorLike(na + nb - 1, shape);
+            T *out = result.data();
+            for (size_t i = 0; i < na; i++) {
+                for (size_t j = 0; j < nb; j++) {
+                    out[i + j] += a[i] * b[j];
+                }
+            }
+            return result;
+        }
+
+        inline MtmVec<double> convolveFft(const double *a, size_t na,
+                                          const double *b, size_t nb,
+                                          const MtmVec<double> &shape) {
+            size_t length = na + nb - 1;
+            size_t m = fastLength(length, true);
+            std::vector<double> padded(m, 0);
+            std::vector<Complex> spectrumA(m / 2 + 1), spectrumB(m / 2 + 1);
+            std::copy(a, a + na, padded.data());
+            realForward(padded.data(), m, spectrumA.data());
+            std::fill(padded.begin(), padded.end(), 0);
+            std::copy(b, b + nb, padded.data());
+            realForward(padded.data(), m, spectrumB.data());
+            for (size_t k = 0; k <= m / 2; k++) {
+                spectrumA[k] = mul(spectrumA[k], spectrumB[k]);
+            }
+            realInverse(spectrumA.data(), m, padded.data());
+            MtmVec<double> result = vectorLike(length, shape);
+            const double norm = 1.0 / (double) m;
+            for (size_t i = 0; i < length; i++) {
+                result.data()[i] = padded[i] * norm;
+            }
+            return result;
+        }
+
+        inline MtmVec<Complex> convolveFft(const Complex *a, size_t na,
+                                           const Complex *b, size_t nb,
+                                           const MtmVec<Complex> &shape) {
+            size_t length = na + nb - 1;
+            size_t m = fastLength(length);
+            std::shared_ptr<const FftPlan> plan = fftPlan(m);
+            std::vector<Complex> buffer(3 * m + plan->inverseScratchSize());
+            Complex *padded = buffer.data();
+            Complex *spectrumA = padded + m;
+            Complex *spectrumB = spectrumA + m;
+            Complex *scratch = spectrumB + m;
+            std::copy(a, a + na, padded);
+            plan->execute(padded, spectrumA, scratch);
+            std::fill(padded, padded + m, Complex());
+            std::copy(b, b + nb, padded);
+            plan->execute(padded, spectrumB, scratch);
+            for (size_t k = 0; k < m; k++) {
+                spectrumA[k] = mul(spectrumA[k], spectrumB[k]);
+            }
+            plan->executeInverse(spectrumA, padded, scratch);
+            MtmVec<Complex> result = vectorLike(length, shape);
+            const double norm = 1.0 / (double) m;
+            for (size_t i = 0; i < length; i++) {
+                result.data()[i] = scale(padded[i], norm);
+            }
+            return result;
+        }
+    }
+
+    //VECTORS
+
+    /*
+     * Transform of a row or column vector, the result has its shape
+     */
+    inline MtmVec<Complex> fft(const MtmVec<Complex> &x,
+                               FftDirection direction = FFT_FORWARD) {
+        std::shared_ptr<const FftPlan> plan = fftPlan(x.size());
+        MtmVec<Complex> result = MtmFftOps::vectorLike(x.size(), x);
+        std::vector<Complex> scratch(plan->inverseScratchSize());
+        MtmFftOps::transformArray(*plan, direction, x.data(), result.data(),
+                                  scratch.data());
+        return result;
+    }
+
+    inline MtmVec<Complex> ifft(const MtmVec<Complex> &x) {
+        return fft(x, FFT_INVERSE);
+    }
+
+    /*
+     * Transform of real input, only the n / 2 + 1 non redundant bins
+     * (the rest are their conjugates). Even lengths run as a complex
+     * transform of half the length.
+     */
+    inline MtmVec<Complex> rfft(const MtmVec<double> &x) {
+        if (x.size() == 0) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        MtmVec<Complex> result = MtmVec<Complex>(x.size() / 2 + 1,
+                                                 Complex());
+        if (x.getDimensions().getRow() == 1 &&
+            x.getDimensions().getCol() != 1) {
+            result.transpose();
+        }
+        MtmFftOps::realForward(x.data(), x.size(), result.data());
+        return result;
+    }
+
+    /*
+     * Inverse of rfft, n is the length of the real signal (the half
+     * spectrum has n / 2 + 1 bins)
+     */
+    inline MtmVec<double> irfft(const MtmVec<Complex> &spectrum, size_t n) {
+        if (n == 0 || spectrum.size() != n / 2 + 1) {
+            throw MtmExceptions::DimensionMismatch(
+                    spectrum.getDimensions(), Dimensions(n / 2 + 1, 1));
+        }
+        MtmVec<double> result = MtmVec<double>(n, 0.0);
+        if (spectrum.getDimensions().getRow() == 1 &&
+            spectrum.getDimensions().getCol() != 1) {
+            result.transpose();
+        }
+        MtmFftOps::realInverse(spectrum.data(), n, result.data());
+        const double norm = 1.0 / (double) n;
+        for (size_t i = 0; i < n; i++) {
+            result.data()[i] *= norm;
+        }
+        return result;
+    }
+
+    /*
+     * Full linear convolution, na + nb - 1 elements shaped like a.
+     * Small inputs are summed directly, bigger ones through zero padded
+     * transforms of a 2^a * 3^b * 5^c length. T is double or Complex.
+     */
+    template<typename T>
+    MtmVec<T> convolve(const MtmVec<T> &a, const MtmVec<T> &b) {
+        if (a.size() == 0 || b.size() == 0) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        if (a.size() * b.size() < CONVOLVE_DIRECT_THRESHOLD ||
+            std::min(a.size(), b.size()) < 32) {
+            return MtmFftOps::convolveDirect(a.data(), a.size(), b.data(),
+                                             b.size(), a);
+        }
+        return MtmFftOps::convolveFft(a.data(), a.size(), b.data(),
+                                      b.size(), a);
+    }
+
+    /*
+     * Full cross correlation, element i is the lag i - (b.size() - 1):
+     * sum over j of a[j + lag] * conj(b[j])
+     */
+    template<typename T>
+    MtmVec<T> correlate(const MtmVec<T> &a, const MtmVec<T> &b) {
+        MtmVec<T> reversed = MtmFftOps::vectorLike(b.size(), b);
+        for (size_t j = 0; j < b.size(); j++) {
+            reversed.data()[j] = MtmFftOps::conjugate(
+                    b.data()[b.size() - 1 - j]);
+        }
+        return convolve(a, reversed);
+    }
+
+    //MATRICES
+
+    /*
+     * In place transform of every row, rows are split between threads
+     */
+    inline void fftRows(MtmMat<Complex> &a,
+                        FftDirection direction = FFT_FORWARD) {
+        size_t rows = (size_t) a.getDimensions().getRow();
+        size_t cols = (size_t) a.getDimensions().getCol();
+        std::shared_ptr<const FftPlan> plan = fftPlan(cols);
+        MtmScheduler::placedFor(
+                0, rows, (1 << 14) / cols + 1,
+                [&a, &plan, direction, cols](size_t first, size_t last) {
+                    std::vector<Complex> buffer(
+                            cols + plan->inverseScratchSize());
+                    for (size_t i = first; i < last; i++) {
+                        Complex *row = a[(index_t) i].data();
+                        std::copy(row, row + cols, buffer.data());
+                        MtmFftOps::transformArray(*plan, direction,
+                                                  buffer.data(), row,
+                                                  buffer.data() + cols);
+                    }
+                });
+    }
+
+    /*
+     * In place transform of every column, each worker gathers its
+     * columns into a contiguous buffer
+     */
+    inline void fftCols(MtmMat<Complex> &a,
+                        FftDirection direction = FFT_FORWARD) {
+        size_t rows = (size_t) a.getDimensions().getRow();
+        size_t cols = (size_t) a.getDimensions().getCol();
+        std::shared_ptr<const FftPlan> plan = fftPlan(rows);
+        MtmScheduler::parallelFor(
+                0, cols, (1 << 14) / rows + 1,
+                [&a, &plan, direction, rows](size_t first, size_t last) {
+                    std::vector<Complex> buffer(
+                            2 * rows + plan->inverseScratchSize());
+                    Complex *column = buffer.data();
+                    Complex *result = column + rows;
+                    for (size_t j = first; j < last; j++) {
+                        for (size_t i = 0; i < rows; i++) {
+                            column[i] = a[(index_t) i].data()[j];
+                        }
+                        MtmFftOps::transformArray(*plan, direction, column,
+                                                  result, result + rows);
+                        for (size_t i = 0; i < rows; i++) {
+                            a[(index_t) i].data()[j] = result[i];
+                        }
+                    }
+                });
+    }
+
+}
+
+#endif //EX3_MTMFFT_H
@@ -0,0 +1,741 @@
+#ifndef EX3_MTMITERATIVE_H
+#define EX3_MTMITERATIVE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmKernels.h"
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+#include "MtmMatBand.h"
+#include "MtmKronecker.h"
+#include "MtmMatSparse.h"
+
+using std::size_t;
+
+/*
+ * Krylov solvers for A * x = b that only need y = A * x, so they run on
+ * systems too big to factor.
+ * A linear operator is any object with
+ *     size_t size() const;                      //A is size() x size()
+ *     void operator()(const T *x, T *y) const;  //y = A * x
+ * linearOperator() wraps MtmMat (and derived), MtmMatSparse, MtmMatBand,
+ * MtmKronecker or a user callback. A preconditioner has the same call operator and
+ * gives z = M^-1 * r.
+ * The solvers take the initial guess in x and leave the solution there.
+ * All scratch vectors come from a SolverWorkspace the caller owns - it
+ * grows on the first solve of a given size and is reused after that, so
+ * the iterations themselves never allocate.
+ * The element type has to be a real floating point type.
+ */
+
+namespace MtmMath {
+
+    /*
+     * Stop conditions, the tolerance is on ||b - A * x|| / ||b||
+     */
+    struct SolverOptions {
+        size_t maxIterations = 1000;
+        double tolerance = 1e-10;
+        size_t restart = 30; //GMRES basis size before a restart
+    };
+
+    struct SolverResult {
+        bool converged;
+        size_t iterations;
+        double residual; //relative to ||b||
+    };
+
+    /*
+     * Scratch memory for the solvers, keep one around between solves
+     */
+    template<typename T>
+    class SolverWorkspace {
+        std::vector<T> storage;
+
+    public:
+        SolverWorkspace() = default;
+
+        /*
+         * Allocates up front for `vectors` vectors of n elements
+         */
+        SolverWorkspace(size_t n, size_t vectors) try
+                : storage(n * vectors) {
+        }
+        catch (std::bad_alloc &e) {
+            throw MtmExceptions::OutOfMemory();
+        }
+
+        /*
+         * At least `elements` elements of scratch memory, only allocates
+         * when the workspace is too small
+         */
+        T *buffer(size_t elements) {
+            if (storage.size() < elements) {
+                try {
+                    storage.resize(elements);
+                }
+                catch (std::bad_alloc &e) {
+                    throw MtmExceptions::OutOfMemory();
+                }
+            }
+            return storage.data();
+        }
+
+        size_t capacity() const {
+            return storage.size();
+        }
+    };
+
+    //OPERATORS
+
+    template<typename T>
+    class DenseOperator {
+        const MtmMat<T> *a;
+        size_t n;
+
+    public:
+        explicit DenseOperator(const MtmMat<T> &a_t)
+                : a(&a_t), n((size_t) a_t.getDimensions().getRow()) {
+            if (a_t.getDimensions().getRow() != a_t.getDimensions().getCol()) {
+                throw MtmExceptions::DimensionMismatch(a_t.getDimensions(),
+                                                       a_t.getDimensions());
+            }
+        }
+
+        size_t size() const {
+            return n;
+        }
+
+        void operator()(const T *x, T *y) const {
+            MTM_STATS_OPERATION(MAT_VEC_MULTIPLY, 2 * n * n);
+            MtmKernels::MatRows<const MtmMat<T>, const T> aRow(*a);
+            if (n * n < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+                MtmKernels::gemvRows(0, n, n, aRow, x, y);
+                return;
+            }
+            MtmScheduler::placedFor(
+                    0, n, MtmKernels::GEMV_PARALLEL_THRESHOLD / n + 1,
+                    [&](size_t first, size_t last) {
+                        MtmKernels::gemvRows(first, last, n, aRow, x, y);
+                    });
+        }
+    };
+
+    /*
+     * MtmMatSparse, MtmMatBand and MtmKronecker all expose multiply(x, y)
+     */
+    template<typename Mat>
+    class StructuredOperator {
+        const Mat *a;
+        size_t n;
+
+    public:
+        explicit StructuredOperator(const Mat &a_t)
+                : a(&a_t), n((size_t) a_t.getDimensions().getRow()) {
+            if (a_t.getDimensions().getRow() != a_t.getDimensions().getCol()) {
+                throw MtmExceptions::DimensionMismatch(a_t.getDimensions(),
+                                                       a_t.getDimensions());
+            }
+        }
+
+        size_t size() const {
+            return n;
+        }
+
+        template<typename T>
+        void operator()(const T *x, T *y) const {
+            a->multiply(x, y);
+        }
+    };
+
+    template<typename F>
+    class CallbackOperator {
+        F f;
+        size_t n;
+
+    public:
+        CallbackOperator(size_t n_t, F f_t) : f(std::move(f_t)), n(n_t) {
+        }
+
+        size_t size() const {
+            return n;
+        }
+
+        template<typename T>
+        void operator()(const T *x, T *y) const {
+            f(x, y);
+        }
+    };
+
+    /*
+     * The operators keep a pointer to the matrix, it has to outlive them
+     */
+    template<typename T>
+    DenseOperator<T> linearOperator(const MtmMat<T> &a) {
+        return DenseOperator<T>(a);
+    }
+
+    template<typename T>
+    StructuredOperator<MtmMatSparse<T>>
+    linearOperator(const MtmMatSparse<T> &a) {
+        return StructuredOperator<MtmMatSparse<T>>(a);
+    }
+
+    template<typename T>
+    StructuredOperator<MtmMatBand<T>> linearOperator(const MtmMatBand<T> &a) {
+        return StructuredOperator<MtmMatBand<T>>(a);
+    }
+
+    template<typename T>
+    StructuredOperator<MtmKronecker<T>>
+    linearOperator(const MtmKronecker<T> &a) {
+        return StructuredOperator<MtmKronecker<T>>(a);
+    }
+
+    /*
+     * f(const T *x, T *y) has to write all n elements of y = A * x
+     */
+    template<typename F>
+    CallbackOperator<F> linearOperator(size_t n, F f) {
+        return CallbackOperator<F>(n, std::move(f));
+    }
+
+    //PRECONDITIONERS
+
+    class IdentityPreconditioner {
+        size_t n;
+
+    public:
+        explicit IdentityPreconditioner(size_t n_t) : n(n_t) {
+        }
+
+        template<typename T>
+        void operator()(const T *r, T *z) const {
+            if (r != z) {
+                std::copy(r, r + n, z);
+            }
+        }
+    };
+
+    /*
+     * M = diag(A), throws SingularMatrix on a zero diagonal element
+     */
+    template<typename T>
+    class JacobiPreconditioner {
+        std::vector<T> inverse;
+
+        template<typename Mat>
+        void fromDiagonal(const Mat &a, size_t n) {
+            inverse.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                T diagonal = a(i, i);
+                if (diagonal == T()) {
+                    throw MtmExceptions::SingularMatrix();
+                }
+                inverse[i] = T(1) / diagonal;
+            }
+        }
+
+    public:
+        explicit JacobiPreconditioner(const MtmMat<T> &a) {
+            size_t n = (size_t) a.getDimensions().getRow();
+            fromDiagonal([&a](size_t i, size_t j) {
+                return a[(index_t) i].data()[j];
+            }, n);
+        }
+
+        explicit JacobiPreconditioner(const MtmMatSparse<T> &a) {
+            fromDiagonal(a, (size_t) a.getDimensions().getRow());
+        }
+
+        explicit JacobiPreconditioner(const MtmMatBand<T> &a) {
+            fromDiagonal(a, (size_t) a.getDimensions().getRow());
+        }
+
+        void operator()(const T *r, T *z) const {
+            const T *scale = inverse.data();
+            for (size_t i = 0; i < inverse.size(); i++) {
+                z[i] = r[i] * scale[i];
+            }
+        }
+    };
+
+    /*
+     * ILU(0) - LU factors of a sparse matrix restricted to the sparsity
+     * pattern of A, so they take exactly the memory of A. For a dense
+     * matrix build it from MtmMatSparse(a), which keeps the non zeros.
+     * Every diagonal element has to be stored and stay non zero during
+     * the factorization, otherwise SingularMatrix is thrown.
+     */
+    template<typename T>
+    class IncompleteLU {
+        size_t n;
+        std::vector<size_t> rowStart;
+        std::vector<size_t> columns;
+        std::vector<T> values; //L below the diagonal (unit), U on and above
+        std::vector<size_t> diagonal; //position of (i, i) in values
+
+    public:
+        explicit IncompleteLU(const MtmMatSparse<T> &a);
+
+        void operator()(const T *r, T *z) const;
+    };
+
+    template<typename T>
+    IncompleteLU<T>::IncompleteLU(const MtmMatSparse<T> &a)
+            : n(a.rows), rowStart(a.rowStart), columns(a.columns),
+              values(a.values), diagonal(a.rows) {
+        if (a.rows != a.cols) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   a.getDimensions());
+        }
+        for (size_t i = 0; i < n; i++) {
+            const size_t *first = columns.data() + rowStart[i];
+            const size_t *last = columns.data() + rowStart[i + 1];
+            const size_t *found = std::lower_bound(first, last, i);
+            if (found == last || *found != i) {
+                throw MtmExceptions::SingularMatrix();
+            }
+            diagonal[i] = found - columns.data();
+        }
+
+        //IKJ elimination, `position` maps a column of row i to its entry
+        std::vector<size_t> position(n, SIZE_MAX);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t e = rowStart[i]; e < rowStart[i + 1]; e++) {
+                position[columns[e]] = e;
+            }
+            for (size_t e = rowStart[i]; e < diagonal[i]; e++) {
+                size_t k = columns[e];
+                values[e] /= values[diagonal[k]];
+                T factor = values[e];
+                for (size_t f = diagonal[k] + 1; f < rowStart[k + 1]; f++) {
+                    size_t target = position[columns[f]];
+                    if (target != SIZE_MAX) {
+                        values[target] -= factor * values[f];
+                    }
+                }
+            }
+            if (values[diagonal[i]] == T()) {
+                throw MtmExceptions::SingularMatrix();
+            }
+            for (size_t e = rowStart[i]; e < rowStart[i + 1]; e++) {
+                position[columns[e]] = SIZE_MAX;
+            }
+        }
+    }
+
+    template<typename T>
+    void IncompleteLU<T>::operator()(const T *r, T *z) const {
+        //L * y = r
+        for (size_t i = 0; i < n; i++) {
+            T sum = r[i];
+            for (size_t e = rowStart[i]; e < diagonal[i]; e++) {
+                sum -= values[e] * z[columns[e]];
+            }
+            z[i] = sum;
+        }
+        //U * z = y
+        for (size_t i = n; i-- > 0;) {
+            T sum = z[i];
+            for (size_t e = diagonal[i] + 1; e < rowStart[i + 1]; e++) {
+                sum -= values[e] * z[columns[e]];
+            }
+            z[i] = sum / values[diagonal[i]];
+        }
+    }
+
+    namespace MtmIterativeOps {
+
+        template<typename T>
+        double norm(const T *x, size_t n) {
+            return std::sqrt((double) MtmKernels::dot(x, x, n));
+        }
+
+        /*
+         * r = b - A * x, returns ||r||
+         */
+        template<typename T, typename Op>
+        double residual(const Op &a, const T *b, const T *x, T *r,
+                        size_t n) {
+            a(x, r);
+            T acc = T();
+            for (size_t i = 0; i < n; i++) {
+                r[i] = b[i] - r[i];
+                acc += r[i] * r[i];
+            }
+            return std::sqrt((double) acc);
+        }
+
+        template<typename T>
+        size_t checkSystem(size_t n, const MtmVec<T> &b, const MtmVec<T> &x) {
+            if (b.size() != n) {
+                throw MtmExceptions::DimensionMismatch(
+                        Dimensions(n, n), b.getDimensions());
+            }
+            if (x.size() != n) {
+                throw MtmExceptions::DimensionMismatch(
+                        Dimensions(n, n), x.getDimensions());
+            }
+            return n;
+        }
+
+        /*
+         * Matrices are wrapped like linearOperator() does, anything
+         * callable as y = A * x on T arrays is used as it is
+         */
+        template<typename T>
+        DenseOperator<T> asOperator(const MtmMat<T> &a) {
+            return DenseOperator<T>(a);
+        }
+
+        template<typename T>
+        StructuredOperator<MtmMatSparse<T>>
+        asOperator(const MtmMatSparse<T> &a) {
+            return StructuredOperator<MtmMatSparse<T>>(a);
+        }
+
+        template<typename T>
+        StructuredOperator<MtmMatBand<T>> asOperator(const MtmMatBand<T> &a) {
+            return StructuredOperator<MtmMatBand<T>>(a);
+        }
+
+        template<typename T>
+        StructuredOperator<MtmKronecker<T>>
+        asOperator(const MtmKronecker<T> &a) {
+            return StructuredOperator<MtmKronecker<T>>(a);
+        }
+
+        template<typename T, typename Op>
+        auto asOperator(const Op &a) -> decltype(
+                a.size(), a(std::declval<const T *>(), std::declval<T *>()),
+                a) {
+            return a;
+        }
+
+        template<typename T>
+        void checkElement() {
+            static_assert(std::is_floating_point<T>::value,
+                          "Krylov solvers need a real floating point type");
+        }
+    }
+
+    //SOLVERS
+
+    /*
+     * Preconditioned conjugate gradients, A and M symmetric positive
+     * definite. 4 vectors of workspace. Each iteration is one A * p, one
+     * M^-1 * r, the p.q and r.z dot products, one fused pass over x, r and
+     * ||r||, and one pass for the new p (it needs beta, so it can not share
+     * the r.z pass).
+     */
+    template<typename T, typename A, typename Pre>
+    SolverResult conjugateGradient(const A &a_t, const MtmVec<T> &b,
+                                   MtmVec<T> &x, const Pre &m,
+                                   SolverWorkspace<T> &workspace,
+                                   const SolverOptions &options =
+                                   SolverOptions()) {
+        MtmIterativeOps::checkElement<T>();
+        const auto &a = MtmIterativeOps::asOperator<T>(a_t);
+        size_t n = MtmIterativeOps::checkSystem(a.size(), b, x);
+        T *r = workspace.buffer(4 * n);
+        T *z = r + n;
+        T *p = z + n;
+        T *q = p + n;
+        T *xs = x.data();
+        const T *bs = b.data();
+
+        double bNorm = MtmIterativeOps::norm(bs, n);
+        if (bNorm == 0) {
+            std::fill(xs, xs + n, T());
+            return SolverResult{true, 0, 0};
+        }
+        double rNorm = MtmIterativeOps::residual(a, bs, xs, r, n);
+        if (rNorm <= options.tolerance * bNorm) {
+            x.allowAllVec();
+            return SolverResult{true, 0, rNorm / bNorm};
+        }
+        m(r, z);
+        std::copy(z, z + n, p);
+        T rz = MtmKernels::dot(r, z, n);
+
+        size_t iteration = 0;
+        while (iteration < options.maxIterations) {
+            iteration++;
+            a(p, q);
+            T pq = MtmKernels::dot(p, q, n);
+            if (pq == T()) {
+                break;
+            }
+            T alpha = rz / pq;
+            T rr = T();
+            for (size_t i = 0; i < n; i++) {
+                xs[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                rr += r[i] * r[i];
+            }
+            rNorm = std::sqrt((double) rr);
+            if (rNorm <= options.tolerance * bNorm) {
+                break;
+            }
+            m(r, z);
+            T rzNext = MtmKernels::dot(r, z, n);
+            T beta = rzNext / rz;
+            for (size_t i = 0; i < n; i++) {
+                p[i] = z[i] + beta * p[i];
+            }
+            rz = rzNext;
+        }
+        x.allowAllVec();
+        return SolverResult{rNorm <= options.tolerance * bNorm, iteration,
+                            rNorm / bNorm};
+    }
+
+    template<typename T, typename A>
+    SolverResult conjugateGradient(const A &a, const MtmVec<T> &b,
+                                   MtmVec<T> &x, SolverWorkspace<T> &workspace,
+                                   const SolverOptions &options =
+                                   SolverOptions()) {
+        return conjugateGradient(a, b, x, IdentityPreconditioner(b.size()),
+                                 workspace, options);
+    }
+
+    /*
+     * Right preconditioned BiCGSTAB for general non symmetric A.
+     * 8 vectors of workspace, two A and two M^-1 products per iteration.
+     */
+    template<typename T, typename A, typename Pre>
+    SolverResult biCGStab(const A &a_t, const MtmVec<T> &b, MtmVec<T> &x,
+                          const Pre &m, SolverWorkspace<T> &workspace,
+                          const SolverOptions &options = SolverOptions()) {
+        MtmIterativeOps::checkElement<T>();
+        const auto &a = MtmIterativeOps::asOperator<T>(a_t);
+        size_t n = MtmIterativeOps::checkSystem(a.size(), b, x);
+        T *r = workspace.buffer(8 * n);
+        T *shadow = r + n;
+        T *p = shadow + n;
+        T *v = p + n;
+        T *pHat = v + n;
+        T *s = pHat + n;
+        T *sHat = s + n;
+        T *t = sHat + n;
+        T *xs = x.data();
+        const T *bs = b.data();
+
+        double bNorm = MtmIterativeOps::norm(bs, n);
+        if (bNorm == 0) {
+            std::fill(xs, xs + n, T());
+            return SolverResult{true, 0, 0};
+        }
+        double rNorm = MtmIterativeOps::residual(a, bs, xs, r, n);
+        double target = options.tolerance * bNorm;
+        std::copy(r, r + n, shadow);
+        std::fill(p, p + n, T());
+        std::fill(v, v + n, T());
+        T rho = T(1);
+        T alpha = T(1);
+        T omega = T(1);
+
+        size_t iteration = 0;
+        while (rNorm > target && iteration < options.maxIterations) {
+            iteration++;
+            T rhoNext = MtmKernels::dot(shadow, r, n);
+            if (rhoNext == T() || omega == T()) {
+                break; //breakdown, the caller can restart from x
+            }
+            T beta = (rhoNext / rho) * (alpha / omega);
+            for (size_t i = 0; i < n; i++) {
+                p[i] = r[i] + beta * (p[i] - omega * v[i]);
+            }
+            m(p, pHat);
+            a(pHat, v);
+            T shadowV = MtmKernels::dot(shadow, v, n);
+            if (shadowV == T()) {
+                break;
+            }
+            alpha = rhoNext / shadowV;
+            T ss = T();
+            for (size_t i = 0; i < n; i++) {
+                s[i] = r[i] - alpha * v[i];
+                ss += s[i] * s[i];
+            }
+            if (std::sqrt((double) ss) <= target) {
+                for (size_t i = 0; i < n; i++) {
+                    xs[i] += alpha * pHat[i];
+                }
+                rNorm = std::sqrt((double) ss);
+                break;
+            }
+            m(s, sHat);
+            a(sHat, t);
+            T ts = T();
+            T tt = T();
+            for (size_t i = 0; i < n; i++) {
+                ts += t[i] * s[i];
+                tt += t[i] * t[i];
+            }
+            omega = tt == T() ? T() : ts / tt;
+            T rr = T();
+            for (size_t i = 0; i < n; i++) {
+                xs[i] += alpha * pHat[i] + omega * sHat[i];
+                r[i] = s[i] - omega * t[i];
+                rr += r[i] * r[i];
+            }
+            rNorm = std::sqrt((double) rr);
+            rho = rhoNext;
+        }
+        x.allowAllVec();
+        return SolverResult{rNorm <= target, iteration, rNorm / bNorm};
+    }
+
+    template<typename T, typename A>
+    SolverResult biCGStab(const A &a, const MtmVec<T> &b, MtmVec<T> &x,
+                          SolverWorkspace<T> &workspace,
+                          const SolverOptions &options = SolverOptions()) {
+        return biCGStab(a, b, x, IdentityPreconditioner(b.size()), workspace,
+                        options);
+    }
+
+    /*
+     * Restarted, right preconditioned GMRES(k) with k = options.restart,
+     * modified Gram-Schmidt and Givens rotations on the Hessenberg matrix.
+     * Workspace is (k + 4) vectors plus O(k^2) for the small problem.
+     * Iterations count inner steps over all restarts.
+     */
+    template<typename T, typename A, typename Pre>
+    SolverResult gmres(const A &a_t, const MtmVec<T> &b, MtmVec<T> &x,
+                       const Pre &m, SolverWorkspace<T> &workspace,
+                       const SolverOptions &options = SolverOptions()) {
+        MtmIterativeOps::checkElement<T>();
+        const auto &a = MtmIterativeOps::asOperator<T>(a_t);
+        size_t n = MtmIterativeOps::checkSystem(a.size(), b, x);
+        if (options.restart == 0) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        size_t k = std::min(options.restart, n);
+        T *basis = workspace.buffer((k + 4) * n + (k + 1) * k + 4 * k + 1);
+        T *w = basis + (k + 1) * n;
+        T *u = w + n;
+        T *z = u + n;
+        T *h = z + n; //column j of the Hessenberg matrix at h + j * (k + 1)
+        T *cosines = h + (k + 1) * k;
+        T *sines = cosines + k;
+        T *y = sines + k;
+        T *g = y + k;
+        T *xs = x.data();
+        const T *bs = b.data();
+
+        double bNorm = MtmIterativeOps::norm(bs, n);
+        if (bNorm == 0) {
+            std::fill(xs, xs + n, T());
+            return SolverResult{true, 0, 0};
+        }
+        double target = options.tolerance * bNorm;
+        double rNorm = MtmIterativeOps::residual(a, bs, xs, basis, n);
+        size_t iteration = 0;
+        while (rNorm > target && iteration < options.maxIterations) {
+            T scale = T(1) / (T) rNorm;
+            for (size_t i = 0; i < n; i++) {
+                basis[i] *= scale;
+            }
+            std::fill(g, g + k + 1, T());
+            g[0] = (T) rNorm;
+
+            size_t steps = 0;
+            while (steps < k && iteration < options.maxIterations) {
+                size_t j = steps++;
+                iteration++;
+                T *column = h + j * (k + 1);
+                m(basis + j * n, z);
+                a(z, w);
+                for (size_t i = 0; i <= j; i++) {
+                    const T *vi = basis + i * n;
+                    T hij = MtmKernels::dot(w, vi, n);
+                    column[i] = hij;
+                    for (size_t e = 0; e < n; e++) {
+                        w[e] -= hij * vi[e];
+                    }
+                }
+                T wNorm = (T) MtmIterativeOps::norm(w, n);
+                column[j + 1] = wNorm;
+                if (wNorm != T()) {
+                    T *next = basis + (j + 1) * n;
+                    T inverse = T(1) / wNorm;
+                    for (size_t e = 0; e < n; e++) {
+                        next[e] = w[e] * inverse;
+                    }
+                }
+                for (size_t i = 0; i < j; i++) {
+                    T top = cosines[i] * column[i] + sines[i] * column[i + 1];
+                    column[i + 1] = -sines[i] * column[i] +
+                                    cosines[i] * column[i + 1];
+                    column[i] = top;
+                }
+                T radius = std::hypot(column[j], column[j + 1]);
+                if (radius == T()) {
+                    cosines[j] = T(1);
+                    sines[j] = T();
+                } else {
+                    cosines[j] = column[j] / radius;
+                    sines[j] = column[j + 1] / radius;
+                }
+                column[j] = radius;
+                column[j + 1] = T();
+                g[j + 1] = -sines[j] * g[j];
+                g[j] = cosines[j] * g[j];
+                rNorm = std::abs((double) g[j + 1]);
+                if (rNorm <= target || wNorm == T()) {
+                    break;
+                }
+            }
+
+            //back substitution on the rotated Hessenberg, then x += M^-1 V y
+            for (size_t i = steps; i-- > 0;) {
+                T sum = g[i];
+                for (size_t l = i + 1; l < steps; l++) {
+                    sum -= h[l * (k + 1) + i] * y[l];
+                }
+                y[i] = h[i * (k + 1) + i] == T() ? T() :
+                       sum / h[i * (k + 1) + i];
+            }
+            std::fill(u, u + n, T());
+            for (size_t i = 0; i < steps; i++) {
+                const T *vi = basis + i * n;
+                for (size_t e = 0; e < n; e++) {
+                    u[e] += y[i] * vi[e];
+                }
+            }
+            m(u, z);
+            for (size_t e = 0; e < n; e++) {
+                xs[e] += z[e];
+            }
+            double estimate = rNorm;
+            rNorm = MtmIterativeOps::residual(a, bs, xs, basis, n);
+            if (rNorm > target && estimate <= target) {
+                continue; //lost accuracy, restart from the true residual
+            }
+            if (steps < k && rNorm > target) {
+                break; //happy breakdown that did not reach the tolerance
+            }
+        }
+        x.allowAllVec();
+        return SolverResult{rNorm <= target, iteration, rNorm / bNorm};
+    }
+
+    template<typename T, typename A>
+    SolverResult gmres(const A &a, const MtmVec<T> &b, MtmVec<T> &x,
+                       SolverWorkspace<T> &workspace,
+                       const SolverOptions &options = SolverOptions()) {
+        return gmres(a, b, x, IdentityPreconditioner(b.size()), workspace,
+                     options);
+    }
+
+}
+
+#endif //EX3_MTMITERATIVE_H
@@ -0,0 +1,437 @@
+#ifndef EX3_MTMKERNELS_H
+#define EX3_MTMKERNELS_H
+
+#include <vector>
+#include <algorithm>
+#include "Auxilaries.h"
+#include "MtmCpu.h"
+
+using std::size_t;
+
+namespace MtmMath {
+    namespace MtmKernels {
+
+        //BLOCK SIZES - chosen so one block of A, B and C fits in L2
+
+        const size_t GEMM_BLOCK_ROWS = 64;
+        const size_t GEMM_BLOCK_DEPTH = 256;
+        const size_t GEMM_BLOCK_COLS = 512;
+
+        //below this many elements a matrix-vector product stays serial
+        const size_t GEMV_PARALLEL_THRESHOLD = 1 << 16;
+
+        //below this many multiply-adds a matrix product stays serial
+        const size_t GEMM_PARALLEL_THRESHOLD = 1 << 20;
+
+        //ROW ACCESSORS
+
+        /*
+         * Row accessor for a plain row-major buffer, row i starts at
+         * base + i * stride
+         */
+        template<typename T>
+        class ContiguousRows {
+            T *base;
+            size_t stride;
+        public:
+            ContiguousRows(T *base_t, size_t stride_t) : base(base_t),
+                                                         stride(stride_t) {}
+
+            T *operator()(size_t i) const {
+                return base + i * stride;
+            }
+        };
+
+        /*
+         * Row accessor for a matrix that stores each row as its own
+         * contiguous vector (MtmMat and friends). Goes straight to the row
+         * storage so no permission checks are done per element.
+         */
+        template<typename Mat, typename T>
+        class MatRows {
+            Mat *mat;
+        public:
+            explicit MatRows(Mat &mat_t) : mat(&mat_t) {}
+
+            T *operator()(size_t i) const {
+                return (*mat)[(index_t) i].data();
+            }
+        };
+
+        template<typename T>
+        ContiguousRows<T> rowsOf(std::vector<T> &buffer, size_t stride) {
+            return ContiguousRows<T>(buffer.data(), stride);
+        }
+
+        template<typename T>
+        ContiguousRows<const T> rowsOf(const std::vector<T> &buffer,
+                                       size_t stride) {
+            return ContiguousRows<const T>(buffer.data(), stride);
+        }
+
+        //GEMM
+
+        /*
+         * Every kernel is written once as xxxPortable, its entry point xxx
+         * runs it through MtmCpu::dispatchFor so it is compiled and
+         * vectorized for the instruction set picked at startup.
+         */
+
+        /*
+         * Blocked multiply-accumulate C += alpha * A * B where A is m x k, B
+         * is k x n and C is m x n. aRow/bRow/cRow map a row index to a
+         * pointer to the start of that row. The innermost loop runs over
+         * contiguous columns of B and C so the compiler can vectorize it.
+         */
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmBlockedPortable(size_t m, size_t n, size_t k,
+                                 const T &alpha, ARows aRow, BRows bRow,
+                                 CRows cRow) {
+            for (size_t ii = 0; ii < m; ii += GEMM_BLOCK_ROWS) {
+                size_t iEnd = std::min(m, ii + GEMM_BLOCK_ROWS);
+                for (size_t pp = 0; pp < k; pp += GEMM_BLOCK_DEPTH) {
+                    size_t pEnd = std::min(k, pp + GEMM_BLOCK_DEPTH);
+                    for (size_t jj = 0; jj < n; jj += GEMM_BLOCK_COLS) {
+                        size_t jEnd = std::min(n, jj + GEMM_BLOCK_COLS);
+                        for (size_t i = ii; i < iEnd; i++) {
+                            const T *a = aRow(i);
+                            T *c = cRow(i);
+                            for (size_t p = pp; p < pEnd; p++) {
+                                const T aip = alpha * a[p];
+                                const T *b = bRow(p);
+                                for (size_t j = jj; j < jEnd; j++) {
+                                    c[j] += aip * b[j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmBlocked(size_t m, size_t n, size_t k, const T &alpha,
+                         ARows aRow, BRows bRow, CRows cRow) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemmBlockedPortable<T>(m, n, k, alpha, aRow, bRow, cRow);
+            });
+        }
+
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmBlocked(size_t m, size_t n, size_t k, ARows aRow,
+                         BRows bRow, CRows cRow) {
+            gemmBlocked<T>(m, n, k, T(1), aRow, bRow, cRow);
+        }
+
+        /*
+         * C += alpha * A^T * B where A is stored k x m. Row p of A scales
+         * row p of B into every row of C, so B and C stay contiguous.
+         */
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTransAPortable(size_t m, size_t n, size_t k,
+                                const T &alpha, ARows aRow, BRows bRow,
+                                CRows cRow) {
+            for (size_t pp = 0; pp < k; pp += GEMM_BLOCK_DEPTH) {
+                size_t pEnd = std::min(k, pp + GEMM_BLOCK_DEPTH);
+                for (size_t i = 0; i < m; i++) {
+                    T *c = cRow(i);
+                    for (size_t p = pp; p < pEnd; p++) {
+                        const T aip = alpha * aRow(p)[i];
+                        const T *b = bRow(p);
+                        for (size_t j = 0; j < n; j++) {
+                            c[j] += aip * b[j];
+                        }
+                    }
+                }
+            }
+        }
+
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTransA(size_t m, size_t n, size_t k, const T &alpha,
+                        ARows aRow, BRows bRow, CRows cRow) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemmTransAPortable<T>(m, n, k, alpha, aRow, bRow, cRow);
+            });
+        }
+
+        /*
+         * C += alpha * A * B^T where B is stored n x k. Every element of C
+         * is a dot product of two contiguous rows.
+         */
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTransBPortable(size_t m, size_t n, size_t k,
+                                const T &alpha, ARows aRow, BRows bRow,
+                                CRows cRow) {
+            for (size_t jj = 0; jj < n; jj += GEMM_BLOCK_ROWS) {
+                size_t jEnd = std::min(n, jj + GEMM_BLOCK_ROWS);
+                for (size_t i = 0; i < m; i++) {
+                    const T *a = aRow(i);
+                    T *c = cRow(i);
+                    for (size_t j = jj; j < jEnd; j++) {
+                        const T *b = bRow(j);
+                        T sum = T();
+                        for (size_t p = 0; p < k; p++) {
+                            sum += a[p] * b[p];
+                        }
+                        c[j] += alpha * sum;
+                    }
+                }
+            }
+        }
+
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTransB(size_t m, size_t n, size_t k, const T &alpha,
+                        ARows aRow, BRows bRow, CRows cRow) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemmTransBPortable<T>(m, n, k, alpha, aRow, bRow, cRow);
+            });
+        }
+
+        /*
+         * C += alpha * A^T * B^T where A is stored k x m and B is n x k
+         */
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTransABPortable(size_t m, size_t n, size_t k,
+                                 const T &alpha, ARows aRow, BRows bRow,
+                                 CRows cRow) {
+            for (size_t j = 0; j < n; j++) {
+                const T *b = bRow(j);
+                for (size_t p = 0; p < k; p++) {
+                    const T bpj = alpha * b[p];
+                    const T *a = aRow(p);
+                    for (size_t i = 0; i < m; i++) {
+                        cRow(i)[j] += a[i] * bpj;
+                    }
+                }
+            }
+        }
+
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTransAB(size_t m, size_t n, size_t k, const T &alpha,
+                         ARows aRow, BRows bRow, CRows cRow) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemmTransABPortable<T>(m, n, k, alpha, aRow, bRow, cRow);
+            });
+        }
+
+        //TRIANGULAR GEMM
+
+        enum Shape {
+            DENSE,
+            UPPER,
+            LOWER
+        };
+
+        /*
+         * Depth range [first, last) row i of an m x k matrix of the given
+         * shape can have non zeros in
+         */
+        inline void shapeRange(Shape shape, size_t i, size_t k, size_t &first,
+                               size_t &last) {
+            first = (shape == UPPER) ? std::min(i, k) : 0;
+            last = (shape == LOWER) ? std::min(i + 1, k) : k;
+        }
+
+        /*
+         * C += A * B like gemmBlocked, where A (m x k) and B (k x n) are
+         * each dense, upper or lower triangular. Row i of A is only read
+         * over its non zero depth range and row p of B over its non zero
+         * columns, so the known zero halves are skipped: triangular times
+         * dense does half the work of a dense product, triangular times
+         * triangular of the same orientation a sixth.
+         */
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTriangularPortable(size_t m, size_t n, size_t k,
+                                    Shape aShape, Shape bShape, ARows aRow,
+                                    BRows bRow, CRows cRow) {
+            for (size_t ii = 0; ii < m; ii += GEMM_BLOCK_ROWS) {
+                size_t iEnd = std::min(m, ii + GEMM_BLOCK_ROWS);
+                for (size_t pp = 0; pp < k; pp += GEMM_BLOCK_DEPTH) {
+                    size_t pEnd = std::min(k, pp + GEMM_BLOCK_DEPTH);
+                    for (size_t i = ii; i < iEnd; i++) {
+                        size_t pFirst, pLast;
+                        shapeRange(aShape, i, k, pFirst, pLast);
+                        pFirst = std::max(pFirst, pp);
+                        pLast = std::min(pLast, pEnd);
+                        const T *a = aRow(i);
+                        T *c = cRow(i);
+                        for (size_t p = pFirst; p < pLast; p++) {
+                            size_t jFirst, jLast;
+                            shapeRange(bShape, p, n, jFirst, jLast);
+                            const T aip = a[p];
+                            const T *b = bRow(p);
+                            for (size_t j = jFirst; j < jLast; j++) {
+                                c[j] += aip * b[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        template<typename T, typename ARows, typename BRows, typename CRows>
+        void gemmTriangular(size_t m, size_t n, size_t k, Shape aShape,
+                            Shape bShape, ARows aRow, BRows bRow,
+                            CRows cRow) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemmTriangularPortable<T>(m, n, k, aShape, bShape, aRow,
+                                          bRow, cRow);
+            });
+        }
+
+        /*
+         * Number of multiply-adds gemmTriangular does for these shapes
+         */
+        inline unsigned long long gemmTriangularCount(size_t m, size_t n,
+                                                      size_t k, Shape aShape,
+                                                      Shape bShape) {
+            unsigned long long count = 0;
+            for (size_t i = 0; i < m; i++) {
+                size_t pFirst, pLast;
+                shapeRange(aShape, i, k, pFirst, pLast);
+                for (size_t p = pFirst; p < pLast; p++) {
+                    size_t jFirst, jLast;
+                    shapeRange(bShape, p, n, jFirst, jLast);
+                    count += jLast - jFirst;
+                }
+            }
+            return count;
+        }
+
+        /*
+         * C = beta * C on m rows of n elements, beta == 0 clears C so
+         * garbage in the output buffer never leaks into the result
+         */
+        template<typename T, typename CRows>
+        void scaleRows(size_t m, size_t n, const T &beta, CRows cRow) {
+            if (beta == T(1)) {
+                return;
+            }
+            bool clear = (beta == T());
+            for (size_t i = 0; i < m; i++) {
+                T *c = cRow(i);
+                for (size_t j = 0; j < n; j++) {
+                    c[j] = clear ? T() : c[j] * beta;
+                }
+            }
+        }
+
+        //GEMV
+
+        /*
+         * Dot product of two contiguous arrays. Four independent partial
+         * sums let the compiler keep them in one vector register.
+         */
+        template<typename T>
+        T dotPortable(const T *a, const T *b, size_t n) {
+            T acc[4] = {T(), T(), T(), T()};
+            size_t j = 0;
+            for (; j + 4 <= n; j += 4) {
+                acc[0] += a[j] * b[j];
+                acc[1] += a[j + 1] * b[j + 1];
+                acc[2] += a[j + 2] * b[j + 2];
+                acc[3] += a[j + 3] * b[j + 3];
+            }
+            for (; j < n; j++) {
+                acc[0] += a[j] * b[j];
+            }
+            return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+        }
+
+        template<typename T>
+        T dot(const T *a, const T *b, size_t n) {
+            T result;
+            MtmCpu::dispatchFor<T>([&] {
+                result = dotPortable(a, b, n);
+            });
+            return result;
+        }
+
+        /*
+         * y[first..last) = A[first..last) * x for an A with n columns
+         */
+        template<typename T, typename ARows>
+        void gemvRowsPortable(size_t first, size_t last, size_t n,
+                              ARows aRow, const T *x, T *y) {
+            for (size_t i = first; i < last; i++) {
+                y[i] = dotPortable(aRow(i), x, n);
+            }
+        }
+
+        template<typename T, typename ARows>
+        void gemvRows(size_t first, size_t last, size_t n, ARows aRow,
+                      const T *x, T *y) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemvRowsPortable(first, last, n, aRow, x, y);
+            });
+        }
+
+        /*
+         * y[first..last) = (x^T * A)[first..last) for an A with m rows,
+         * done as row-wise axpys so both loads and stores are contiguous
+         */
+        template<typename T, typename ARows>
+        void gemvTransColsPortable(size_t first, size_t last, size_t m,
+                                   ARows aRow, const T *x, T *y) {
+            for (size_t j = first; j < last; j++) {
+                y[j] = T();
+            }
+            for (size_t i = 0; i < m; i++) {
+                const T *row = aRow(i);
+                const T scale = x[i];
+                for (size_t j = first; j < last; j++) {
+                    y[j] += scale * row[j];
+                }
+            }
+        }
+
+        template<typename T, typename ARows>
+        void gemvTransCols(size_t first, size_t last, size_t m, ARows aRow,
+                           const T *x, T *y) {
+            MtmCpu::dispatchFor<T>([&] {
+                gemvTransColsPortable(first, last, m, aRow, x, y);
+            });
+        }
+
+        /*
+         * 3M (Gauss) complex multiply on split real/imaginary planes:
+         * (Ar + iAi)(Br + iBi) is built from three real products
+         * T1 = Ar*Br, T2 = Ai*Bi, T3 = (Ar+Ai)(Br+Bi) as
+         * Cr = T1 - T2, Ci = T3 - T1 - T2.
+         * All planes are dense row-major, A is m x k, B is k x n and Cr/Ci
+         * are overwritten with the m x n result.
+         * Saves a quarter of the multiplies at the cost of slightly larger
+         * rounding error in the imaginary part.
+         */
+        template<typename T>
+        void gemm3M(size_t m, size_t n, size_t k,
+                    const std::vector<T> &ar, const std::vector<T> &ai,
+                    const std::vector<T> &br, const std::vector<T> &bi,
+                    std::vector<T> &cr, std::vector<T> &ci) {
+            std::vector<T> aSum(m * k), bSum(k * n), t2(m * n, T());
+            for (size_t i = 0; i < m * k; i++) {
+                aSum[i] = ar[i] + ai[i];
+            }
+            for (size_t i = 0; i < k * n; i++) {
+                bSum[i] = br[i] + bi[i];
+            }
+
+            cr.assign(m * n, T());
+            ci.assign(m * n, T());
+            gemmBlocked<T>(m, n, k, rowsOf(ar, k), rowsOf(br, n),
+                           rowsOf(cr, n));
+            gemmBlocked<T>(m, n, k, rowsOf(ai, k), rowsOf(bi, n),
+                           rowsOf(t2, n));
+            gemmBlocked<T>(m, n, k, rowsOf(aSum, k), rowsOf(bSum, n),
+                           rowsOf(ci, n));
+
+            for (size_t i = 0; i < m * n; i++) {
+                ci[i] -= cr[i] + t2[i];
+                cr[i] -= t2[i];
+            }
+        }
+
+    }
+}
+
+#endif //EX3_MTMKERNELS_H
@@ -0,0 +1,174 @@
+#ifndef EX3_MTMKRONECKER_H
+#define EX3_MTMKRONECKER_H
+
+#include <vector>
+#include <algorithm>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmKernels.h"
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+namespace MtmMath {
+
+    /*
+     * Outer product u * v^T as a u.size() x v.size() matrix, u and v can
+     * be row or column vectors
+     */
+    template<typename T>
+    MtmMat<T> outer(const MtmVec<T> &u, const MtmVec<T> &v) {
+        MtmMat<T> result = MtmMat<T>(Dimensions(u.size(), v.size()), T());
+        const T *in = v.data();
+        for (size_t i = 0; i < u.size(); i++) {
+            const T scale = u.data()[i];
+            T *row = result[(index_t) i].data();
+            for (size_t j = 0; j < v.size(); j++) {
+                row[j] = scale * in[j];
+            }
+        }
+        return result;
+    }
+
+    /*
+     * Lazy Kronecker product A (x) B of an m x n A and a p x q B - an
+     * (m * p) x (n * q) matrix whose element (i * p + k, j * q + l) is
+     * A(i, j) * B(k, l). Only the two factors are stored.
+     * A matrix-vector product is done as Y = A * X * B^T on the vector
+     * reshaped to n x q, which takes O(nq * p + mn * p) instead of the
+     * O(mn * pq) of the formed matrix and an n x p temporary.
+     * The temporary is kept in the object, so multiply does not allocate,
+     * and one MtmKronecker must not be multiplied by two threads at once.
+     * A square one can be passed to the iterative solvers as it is, or
+     * wrapped with linearOperator().
+     */
+    template<typename T>
+    class MtmKronecker {
+        MtmMat<T> a;
+        MtmMat<T> b;
+        size_t m, n, p, q;
+        //Z = X * B^T of the last multiply, n x p
+        mutable std::vector<T> scratch;
+
+    public:
+        MtmKronecker(const MtmMat<T> &a_t, const MtmMat<T> &b_t)
+                : a(a_t), b(b_t),
+                  m((size_t) a_t.getDimensions().getRow()),
+                  n((size_t) a_t.getDimensions().getCol()),
+                  p((size_t) b_t.getDimensions().getRow()),
+                  q((size_t) b_t.getDimensions().getCol()),
+                  scratch(n * p) {
+        }
+
+        MtmKronecker(const MtmKronecker<T> &toCopy) = default;
+
+        ~MtmKronecker() = default;
+
+        MtmKronecker &operator=(const MtmKronecker<T> &c) = default;
+
+        Dimensions getDimensions() const {
+            return Dimensions(m * p, n * q);
+        }
+
+        const MtmMat<T> &getLeft() const {
+            return a;
+        }
+
+        const MtmMat<T> &getRight() const {
+            return b;
+        }
+
+        T operator()(size_t row, size_t col) const {
+            if (row >= m * p || col >= n * q) {
+                throw MtmExceptions::AccessIllegalElement();
+            }
+            return a[(index_t) (row / p)].data()[col / q] *
+                   b[(index_t) (row % p)].data()[col % q];
+        }
+
+        /*
+         * y = (A (x) B) * x on raw arrays of n * q and m * p elements
+         */
+        void multiply(const T *x, T *y) const;
+
+        /*
+         * Forms the whole (m * p) x (n * q) matrix, for small factors only
+         */
+        MtmMat<T> toMat() const;
+    };
+
+    template<typename T>
+    void MtmKronecker<T>::multiply(const T *x, T *y) const {
+        MTM_STATS_OPERATION(KRONECKER_MULTIPLY, 2 * (n * q * p + m * n * p));
+
+        //Z = X * B^T, every element a dot of two contiguous rows
+        std::vector<T> &z = scratch;
+        for (size_t j = 0; j < n; j++) {
+            const T *xRow = x + j * q;
+            T *zRow = z.data() + j * p;
+            for (size_t k = 0; k < p; k++) {
+                zRow[k] = MtmKernels::dot(xRow, b[(index_t) k].data(), q);
+            }
+        }
+
+        //Y = A * Z, m x p, which is y in row-major order
+        auto rowsBody = [this, &z, y](size_t first, size_t last) {
+            std::fill(y + first * p, y + last * p, T());
+            MtmKernels::gemmBlocked<T>(
+                    last - first, p, n,
+                    [this, first](size_t i) {
+                        return a[(index_t) (first + i)].data();
+                    },
+                    MtmKernels::ContiguousRows<const T>(z.data(), p),
+                    MtmKernels::ContiguousRows<T>(y + first * p, p));
+        };
+        if (m * n * p < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+            rowsBody(0, m);
+            return;
+        }
+        MtmScheduler::parallelFor(
+                0, m, MtmKernels::GEMV_PARALLEL_THRESHOLD / (n * p) + 1,
+                rowsBody);
+    }
+
+    template<typename T>
+    MtmMat<T> MtmKronecker<T>::toMat() const {
+        MtmMat<T> result = MtmMat<T>(getDimensions(), T());
+        for (size_t i = 0; i < m; i++) {
+            const T *aRow = a[(index_t) i].data();
+            for (size_t k = 0; k < p; k++) {
+                const T *bRow = b[(index_t) k].data();
+                T *row = result[(index_t) (i * p + k)].data();
+                for (size_t j = 0; j < n; j++) {
+                    for (size_t l = 0; l < q; l++) {
+                        row[j * q + l] = aRow[j] * bRow[l];
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    template<typename T>
+    MtmKronecker<T> kron(const MtmMat<T> &a, const MtmMat<T> &b) {
+        return MtmKronecker<T>(a, b);
+    }
+
+    /*
+     * (A (x) B) times a column vector of n * q elements
+     */
+    template<typename T>
+    MtmVec<T> operator*(const MtmKronecker<T> &k, const MtmVec<T> &x) {
+        Dimensions dim = k.getDimensions();
+        if (x.getDimensions() != Dimensions((size_t) dim.getCol(), 1)) {
+            throw MtmExceptions::DimensionMismatch(dim, x.getDimensions());
+        }
+        MtmVec<T> result = MtmVec<T>((size_t) dim.getRow(), T());
+        k.multiply(x.data(), result.data());
+        return result;
+    }
+
+}
+
+#endif //EX3_MTMKRONECKER_H
@@ -0,0 +1,170 @@
+#ifndef EX3_MTMLU_H
+#define EX3_MTMLU_H
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmMatSq.h"
+
+using std::size_t;
+
+namespace MtmMath {
+
+    /*
+     * Size of an element used to pick the pivot row
+     */
+    template<typename T>
+    double pivotMagnitude(const T &x) {
+        return x < T() ? (double) -x : (double) x;
+    }
+
+    inline double pivotMagnitude(const Complex &x) {
+        return x.getReal() * x.getReal() + x.getImag() * x.getImag();
+    }
+
+    /*
+     * LU factorization with partial pivoting, P * A = L * U.
+     * L (unit diagonal, not stored) and U share one square matrix and the
+     * row permutation is kept as the original row index of every row.
+     * Throws SingularMatrix if a column has no usable pivot.
+     * Needs an exact division, so built in integer element types are
+     * rejected (convert to double, or use ModInt).
+     */
+    template<typename T>
+    class LUDecomposition {
+        static_assert(!std::is_integral<T>::value,
+                      "LUDecomposition needs a field, integer division "
+                      "truncates");
+
+        MtmMatSq<T> factors;
+        std::vector<size_t> pivots;
+        int swaps;
+
+    public:
+        explicit LUDecomposition(const MtmMatSq<T> &a);
+
+        LUDecomposition(const LUDecomposition<T> &toCopy) = default;
+
+        ~LUDecomposition() = default;
+
+        const MtmMatSq<T> &getFactors() const {
+            return factors;
+        }
+
+        const std::vector<size_t> &getPivots() const {
+            return pivots;
+        }
+
+        /*
+         * Solves A * x = b for a column vector b
+         */
+        MtmVec<T> solve(const MtmVec<T> &b) const;
+
+        T determinant() const;
+    };
+
+    namespace MtmLUOps {
+
+        /*
+         * In place elimination with partial pivoting, returns the number
+         * of row swaps. Element types with a cheaper exact scheme
+         * overload luFactorize in their own namespace (found by ADL).
+         */
+        template<typename T>
+        int luFactorize(MtmMatSq<T> &factors, std::vector<size_t> &pivots) {
+            size_t n = pivots.size();
+            int swaps = 0;
+            for (size_t k = 0; k < n; k++) {
+                size_t best = k;
+                double bestSize = pivotMagnitude(factors[(index_t) k].data()[k]);
+                for (size_t i = k + 1; i < n; i++) {
+                    double size = pivotMagnitude(factors[(index_t) i].data()[k]);
+                    if (size > bestSize) {
+                        best = i;
+                        bestSize = size;
+                    }
+                }
+                if (bestSize == 0) {
+                    throw MtmExceptions::SingularMatrix();
+                }
+                if (best != k) {
+                    //rows are separate vectors, so swapping them is O(1)
+                    factors[(index_t) k].swap(factors[(index_t) best]);
+                    std::swap(pivots[k], pivots[best]);
+                    swaps++;
+                }
+
+                const T *pivotRow = factors[(index_t) k].data();
+                const T pivot = pivotRow[k];
+                for (size_t i = k + 1; i < n; i++) {
+                    T *row = factors[(index_t) i].data();
+                    if (row[k] == T()) {
+                        continue;
+                    }
+                    const T factor = row[k] / pivot;
+                    row[k] = factor;
+                    for (size_t j = k + 1; j < n; j++) {
+                        row[j] -= factor * pivotRow[j];
+                    }
+                }
+            }
+            return swaps;
+        }
+    }
+
+    template<typename T>
+    LUDecomposition<T>::LUDecomposition(const MtmMatSq<T> &a) : factors(a),
+                                                               swaps(0) {
+        size_t n = (size_t) factors.getDimensions().getRow();
+        factors.allowAllVec();
+        pivots.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            pivots[i] = i;
+        }
+        using MtmLUOps::luFactorize;
+        swaps = luFactorize(factors, pivots);
+    }
+
+    template<typename T>
+    MtmVec<T> LUDecomposition<T>::solve(const MtmVec<T> &b) const {
+        size_t n = pivots.size();
+        if (b.getDimensions() != Dimensions(n, 1)) {
+            throw MtmExceptions::DimensionMismatch(factors.getDimensions(),
+                                                   b.getDimensions());
+        }
+
+        MtmVec<T> result = MtmVec<T>(n, T());
+        T *x = result.data();
+        for (size_t i = 0; i < n; i++) {
+            x[i] = b[(index_t) pivots[i]];
+        }
+        for (size_t i = 1; i < n; i++) {
+            const T *row = factors[(index_t) i].data();
+            for (size_t j = 0; j < i; j++) {
+                x[i] -= row[j] * x[j];
+            }
+        }
+        for (size_t i = n; i-- > 0;) {
+            const T *row = factors[(index_t) i].data();
+            for (size_t j = i + 1; j < n; j++) {
+                x[i] -= row[j] * x[j];
+            }
+            x[i] = x[i] / row[i];
+        }
+        return result;
+    }
+
+    template<typename T>
+    T LUDecomposition<T>::determinant() const {
+        T result = factors[0][0];
+        for (size_t i = 1; i < pivots.size(); i++) {
+            result *= factors[(index_t) i][(index_t) i];
+        }
+        return (swaps % 2) ? -result : result;
+    }
+
+}
+
+#endif //EX3_MTMLU_H
@@ -0,0 +1,638 @@
+#ifndef EX3_MTMLOAD_H
+#define EX3_MTMLOAD_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "Complex.h"
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+#include "MtmMatSparse.h"
+
+using std::size_t;
+
+/*
+ * Parallel loaders for CSV and MatrixMarket text files.
+ * The file is read into memory once and cut into byte ranges on line
+ * boundaries. Every range is parsed on its own thread with
+ * std::from_chars and the values are written straight into the row storage
+ * of the result, so no per element checks or locks are involved.
+ * Supported element types are int, double and Complex. An int element may
+ * be written as a whole real ("3.0"). A Complex value is written as
+ * "re im" (an 'i' after im is allowed, as in Complex::to_string) and can
+ * be read from real or integer data as well.
+ * A file that cannot be read or does not parse throws MalformedStream.
+ */
+
+namespace MtmMath {
+    namespace MtmLoad {
+
+        namespace MtmLoadOps {
+
+            inline std::vector<char> readFile(const std::string &path) {
+                std::ifstream file(path, std::ios::binary | std::ios::ate);
+                if (!file) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                std::streamsize size = file.tellg();
+                std::vector<char> buffer;
+                try {
+                    buffer.resize((size_t) size);
+                }
+                catch (std::bad_alloc &e) {
+                    throw MtmExceptions::OutOfMemory();
+                }
+                file.seekg(0);
+                if (!file.read(buffer.data(), size)) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                return buffer;
+            }
+
+            inline const char *nextLine(const char *p, const char *end) {
+                if (p >= end) {
+                    return end;
+                }
+                const char *newline = (const char *) memchr(p, '\n', end - p);
+                return newline ? newline + 1 : end;
+            }
+
+            inline const char *lineEnd(const char *p, const char *end) {
+                if (p >= end) {
+                    return end;
+                }
+                const char *newline = (const char *) memchr(p, '\n', end - p);
+                return newline ? newline : end;
+            }
+
+            inline const char *skipSpaces(const char *p, const char *end) {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                    p++;
+                }
+                return p;
+            }
+
+            /*
+             * Data lines are the ones that are not blank or comments
+             */
+            inline bool isData(const char *p, const char *end,
+                               char comment) {
+                p = skipSpaces(p, end);
+                return p < end && *p != comment;
+            }
+
+            /*
+             * Cuts [begin, end) into up to parts ranges that start at the
+             * beginning of a line, returns the parts + 1 boundaries
+             */
+            inline std::vector<const char *> splitLines(const char *begin,
+                                                        const char *end,
+                                                        size_t parts) {
+                std::vector<const char *> bounds(1, begin);
+                size_t length = (size_t) (end - begin);
+                for (size_t k = 1; k < parts; k++) {
+                    const char *cut = begin + length / parts * k;
+                    cut = std::max(cut, bounds.back());
+                    if (cut > begin && cut[-1] != '\n') {
+                        cut = nextLine(cut, end);
+                    }
+                    bounds.push_back(cut);
+                }
+                bounds.push_back(end);
+                return bounds;
+            }
+
+            /*
+             * Calls f(lineBegin, lineEnd) for every data line in the range
+             */
+            template<typename F>
+            void forEachDataLine(const char *begin, const char *end,
+                                 char comment, F f) {
+                for (const char *p = begin; p < end;) {
+                    const char *last = lineEnd(p, end);
+                    if (isData(p, last, comment)) {
+                        f(p, last);
+                    }
+                    p = nextLine(last, end);
+                }
+            }
+
+            /*
+             * Number of data lines in every range, in parallel
+             */
+            inline std::vector<size_t>
+            countDataLines(const std::vector<const char *> &bounds,
+                           char comment) {
+                std::vector<size_t> counts(bounds.size() - 1, 0);
+                MtmScheduler::parallelFor(
+                        0, counts.size(), 1, [&](size_t first, size_t last) {
+                            for (size_t k = first; k < last; k++) {
+                                forEachDataLine(bounds[k], bounds[k + 1],
+                                                comment,
+                                                [&](const char *,
+                                                    const char *) {
+                                                    counts[k]++;
+                                                });
+                            }
+                        });
+                return counts;
+            }
+
+            inline size_t rangeCount() {
+                return MtmScheduler::defaultScheduler().workerCount() * 4;
+            }
+
+            template<typename U>
+            const char *parseNumber(const char *p, const char *end, U &out) {
+                p = skipSpaces(p, end);
+                if (p < end && *p == '+') {
+                    p++;
+                }
+                std::from_chars_result parsed = std::from_chars(p, end, out);
+                if (parsed.ec != std::errc()) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                return parsed.ptr;
+            }
+
+            template<typename T>
+            const char *parseScalar(const char *p, const char *end, T &out,
+                                    std::false_type) {
+                return parseNumber(p, end, out);
+            }
+
+            /*
+             * An integer written as a real ("1.0", "2e0") is read as a
+             * double, which has to be whole and fit in T
+             */
+            template<typename T>
+            const char *parseScalar(const char *p, const char *end, T &out,
+                                    std::true_type) {
+                const char *stop = parseNumber(p, end, out);
+                if (stop == end ||
+                    (*stop != '.' && *stop != 'e' && *stop != 'E')) {
+                    return stop;
+                }
+                double value = 0;
+                stop = parseNumber(p, end, value);
+                if (value != std::floor(value) ||
+                    !(value >= (double) std::numeric_limits<T>::min() &&
+                      value < std::ldexp(1.0,
+                                         std::numeric_limits<T>::digits))) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                out = (T) value;
+                return stop;
+            }
+
+            /*
+             * Reads one element starting at p, returns where it stopped
+             */
+            template<typename T>
+            const char *parseValue(const char *p, const char *end, T &out) {
+                return parseScalar(p, end, out, std::is_integral<T>());
+            }
+
+            inline const char *parseValue(const char *p, const char *end,
+                                          Complex &out) {
+                double re = 0;
+                double im = 0;
+                p = skipSpaces(parseNumber(p, end, re), end);
+                if (p < end && (isdigit((unsigned char) *p) || *p == '-' ||
+                                *p == '+' || *p == '.')) {
+                    p = parseNumber(p, end, im);
+                    if (p < end && *p == 'i') {
+                        p++;
+                    }
+                }
+                out = Complex(re, im);
+                return p;
+            }
+
+            /*
+             * Reads the element that ends the line [p, end), anything but
+             * spaces after it throws MalformedStream
+             */
+            template<typename T>
+            void parseLastValue(const char *p, const char *end, T &out) {
+                if (skipSpaces(parseValue(p, end, out), end) != end) {
+                    throw MtmExceptions::MalformedStream();
+                }
+            }
+
+            template<typename T>
+            T conjugate(const T &x) {
+                return x;
+            }
+
+            inline Complex conjugate(const Complex &x) {
+                return Complex(x.getReal(), -x.getImag());
+            }
+
+            //MATRIX MARKET
+
+            enum Field {
+                INTEGER_FIELD,
+                REAL_FIELD,
+                COMPLEX_FIELD,
+                PATTERN_FIELD
+            };
+
+            enum Symmetry {
+                GENERAL,
+                SYMMETRIC,
+                SKEW_SYMMETRIC,
+                HERMITIAN
+            };
+
+            struct MarketHeader {
+                bool coordinate;
+                bool pattern;
+                Field field;
+                Symmetry symmetry;
+                size_t rows;
+                size_t cols;
+                size_t entries;
+                const char *data;
+            };
+
+            inline std::string lowerWord(const char *&p, const char *end) {
+                p = skipSpaces(p, end);
+                std::string word;
+                while (p < end && !isspace((unsigned char) *p)) {
+                    word += (char) tolower((unsigned char) *p++);
+                }
+                return word;
+            }
+
+            /*
+             * Reads the banner, skips the comments and reads the size line
+             */
+            inline MarketHeader readMarketHeader(const char *begin,
+                                                 const char *end) {
+                const char *last = lineEnd(begin, end);
+                const char *p = begin;
+                std::string banner = lowerWord(p, last);
+                std::string object = lowerWord(p, last);
+                std::string format = lowerWord(p, last);
+                std::string field = lowerWord(p, last);
+                std::string symmetry = lowerWord(p, last);
+                if (banner != "%%matrixmarket" || object != "matrix" ||
+                    (format != "coordinate" && format != "array") ||
+                    (field != "real" && field != "double" &&
+                     field != "integer" && field != "complex" &&
+                     field != "pattern") ||
+                    (format == "array" && field == "pattern")) {
+                    throw MtmExceptions::MalformedStream();
+                }
+
+                MarketHeader header;
+                header.coordinate = (format == "coordinate");
+                header.pattern = (field == "pattern");
+                header.field = field == "integer" ? INTEGER_FIELD :
+                               field == "complex" ? COMPLEX_FIELD :
+                               header.pattern ? PATTERN_FIELD : REAL_FIELD;
+                if (symmetry == "general") {
+                    header.symmetry = GENERAL;
+                } else if (symmetry == "symmetric") {
+                    header.symmetry = SYMMETRIC;
+                } else if (symmetry == "skew-symmetric") {
+                    header.symmetry = SKEW_SYMMETRIC;
+                } else if (symmetry == "hermitian") {
+                    header.symmetry = HERMITIAN;
+                } else {
+                    throw MtmExceptions::MalformedStream();
+                }
+
+                p = nextLine(begin, end);
+                while (p < end && !isData(p, lineEnd(p, end), '%')) {
+                    p = nextLine(p, end);
+                }
+                last = lineEnd(p, end);
+                p = parseNumber(p, last, header.rows);
+                p = parseNumber(p, last, header.cols);
+                if (header.coordinate) {
+                    p = parseNumber(p, last, header.entries);
+                } else {
+                    header.entries = header.rows * header.cols;
+                }
+                if (header.rows == 0 || header.cols == 0 ||
+                    (header.symmetry != GENERAL &&
+                     header.rows != header.cols)) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                header.data = nextLine(last, end);
+                return header;
+            }
+
+            /*
+             * Complex data only loads as Complex instead of silently
+             * dropping the imaginary part. Real data may load into an
+             * integer type, every value then has to be a whole number
+             * ("1.0" and "2e0" load, "1.5" throws MalformedStream).
+             */
+            template<typename T>
+            void checkField(const MarketHeader &header) {
+                if (header.field == COMPLEX_FIELD &&
+                    !std::is_same<T, Complex>::value) {
+                    throw MtmExceptions::MalformedStream();
+                }
+            }
+
+            template<typename T, typename Store>
+            void storeMirrored(Symmetry symmetry, size_t i, size_t j,
+                               const T &value, Store store) {
+                store(i, j, value);
+                if (symmetry == GENERAL || i == j) {
+                    return;
+                }
+                if (symmetry == SYMMETRIC) {
+                    store(j, i, value);
+                } else if (symmetry == SKEW_SYMMETRIC) {
+                    store(j, i, -value);
+                } else {
+                    store(j, i, conjugate(value));
+                }
+            }
+
+            /*
+             * Parses the coordinate entries of every range in parallel and
+             * calls store(range, i, j, value) (0 based) for each stored
+             * element and its mirror image, a range is only ever handled by
+             * one thread. Returns the number of entry lines.
+             */
+            template<typename T, typename Store>
+            size_t parseCoordinates(const MarketHeader &header,
+                                    const char *end, Store store) {
+                std::vector<const char *> bounds = splitLines(header.data,
+                                                              end,
+                                                              rangeCount());
+                std::atomic<size_t> lines(0);
+                MtmScheduler::parallelFor(
+                        0, bounds.size() - 1, 1,
+                        [&](size_t first, size_t last) {
+                            size_t count = 0;
+                            for (size_t k = first; k < last; k++) {
+                                forEachDataLine(
+                                        bounds[k], bounds[k + 1], '%',
+                                        [&](const char *p, const char *e) {
+                                            size_t i, j;
+                                            T value = T(1);
+                                            p = parseNumber(p, e, i);
+                                            p = parseNumber(p, e, j);
+                                            if (header.pattern) {
+                                                if (skipSpaces(p, e) != e) {
+                                                    throw MtmExceptions::
+                                                    MalformedStream();
+                                                }
+                                            } else {
+                                                parseLastValue(p, e, value);
+                                            }
+                                            if (i == 0 || j == 0 ||
+                                                i > header.rows ||
+                                                j > header.cols) {
+                                                throw MtmExceptions::
+                                                MalformedStream();
+                                            }
+                                            storeMirrored(
+                                                    header.symmetry, i - 1,
+                                                    j - 1, value,
+                                                    [&store, k](size_t r,
+                                                                size_t c,
+                                                                const T &v) {
+                                                        store(k, r, c, v);
+                                                    });
+                                            count++;
+                                        });
+                            }
+                            lines.fetch_add(count);
+                        });
+                return lines.load();
+            }
+
+            /*
+             * Array entries are listed column by column, only the lower
+             * triangle (without the diagonal for skew-symmetric) when the
+             * matrix has a symmetry. Position holds the (i, j) of the
+             * next entry.
+             */
+            struct ArrayPosition {
+                size_t i;
+                size_t j;
+                size_t rows;
+                size_t skip;
+
+                ArrayPosition(const MarketHeader &header, size_t k)
+                        : i(0), j(0), rows(header.rows),
+                          skip(header.symmetry == GENERAL ? rows :
+                               header.symmetry == SKEW_SYMMETRIC ? 1 : 0) {
+                    if (skip == rows) {
+                        i = k % rows;
+                        j = k / rows;
+                        return;
+                    }
+                    i = j + skip;
+                    while (j < rows && k >= rows - i) {
+                        k -= rows - i;
+                        j++;
+                        i = j + skip;
+                    }
+                    i += k;
+                }
+
+                void next() {
+                    if (++i < rows) {
+                        return;
+                    }
+                    j++;
+                    i = skip == rows ? 0 : j + skip;
+                }
+            };
+
+            inline size_t arrayEntries(const MarketHeader &header) {
+                size_t n = header.rows;
+                if (header.symmetry == GENERAL) {
+                    return n * header.cols;
+                }
+                return header.symmetry == SKEW_SYMMETRIC ? n * (n - 1) / 2 :
+                       n * (n + 1) / 2;
+            }
+
+            template<typename T>
+            void parseArray(const MarketHeader &header, const char *end,
+                            MtmMat<T> &result) {
+                std::vector<const char *> bounds = splitLines(header.data,
+                                                              end,
+                                                              rangeCount());
+                std::vector<size_t> counts = countDataLines(bounds, '%');
+                std::vector<size_t> firstEntry(counts.size() + 1, 0);
+                for (size_t k = 0; k < counts.size(); k++) {
+                    firstEntry[k + 1] = firstEntry[k] + counts[k];
+                }
+                if (firstEntry.back() != arrayEntries(header)) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                auto store = [&result](size_t i, size_t j, const T &value) {
+                    result[(index_t) i].data()[j] = value;
+                };
+                MtmScheduler::parallelFor(
+                        0, counts.size(), 1, [&](size_t first, size_t last) {
+                            for (size_t k = first; k < last; k++) {
+                                ArrayPosition at(header, firstEntry[k]);
+                                forEachDataLine(
+                                        bounds[k], bounds[k + 1], '%',
+                                        [&](const char *p, const char *e) {
+                                            T value;
+                                            parseLastValue(p, e, value);
+                                            storeMirrored(header.symmetry,
+                                                          at.i, at.j, value,
+                                                          store);
+                                            at.next();
+                                        });
+                            }
+                        });
+            }
+        }
+
+        /*
+         * Loads a CSV file of numbers, one matrix row per line. Every line
+         * needs the same number of fields, blank lines are skipped and
+         * skipHeader drops the first line. The delimiter can not be a space
+         * or a tab.
+         */
+        template<typename T>
+        MtmMat<T> loadCsv(const std::string &path, char delimiter = ',',
+                          bool skipHeader = false) {
+            using namespace MtmLoadOps;
+            std::vector<char> buffer = readFile(path);
+            const char *begin = buffer.data();
+            const char *end = begin + buffer.size();
+            if (skipHeader) {
+                begin = nextLine(begin, end);
+            }
+
+            std::vector<const char *> bounds = splitLines(begin, end,
+                                                          rangeCount());
+            std::vector<size_t> counts = countDataLines(bounds, '\0');
+            std::vector<size_t> firstRow(counts.size() + 1, 0);
+            for (size_t k = 0; k < counts.size(); k++) {
+                firstRow[k + 1] = firstRow[k] + counts[k];
+            }
+            size_t rows = firstRow.back();
+            if (rows == 0) {
+                throw MtmExceptions::MalformedStream();
+            }
+            size_t cols = 0;
+            forEachDataLine(begin, end, '\0',
+                            [&cols, delimiter](const char *p, const char *e) {
+                                if (cols == 0) {
+                                    cols = std::count(p, e, delimiter) + 1;
+                                }
+                            });
+
+            MtmMat<T> result = MtmMat<T>(Dimensions(rows, cols), T());
+            MtmScheduler::parallelFor(
+                    0, counts.size(), 1, [&](size_t first, size_t last) {
+                        for (size_t k = first; k < last; k++) {
+                            size_t i = firstRow[k];
+                            forEachDataLine(
+                                    bounds[k], bounds[k + 1], '\0',
+                                    [&](const char *p, const char *e) {
+                                        T *row = result[(index_t) i++].data();
+                                        for (size_t j = 0; j < cols; j++) {
+                                            p = skipSpaces(
+                                                    parseValue(p, e, row[j]),
+                                                    e);
+                                            bool lastField = (j + 1 == cols);
+                                            if (lastField ? p != e :
+                                                p == e || *p != delimiter) {
+                                                throw MtmExceptions::
+                                                MalformedStream();
+                                            }
+                                            p++;
+                                        }
+                                    });
+                        }
+                    });
+            return result;
+        }
+
+        /*
+         * Loads a MatrixMarket file (coordinate or array, any field and
+         * symmetry) into a dense matrix
+         */
+        template<typename T>
+        MtmMat<T> loadMatrixMarket(const std::string &path) {
+            using namespace MtmLoadOps;
+            std::vector<char> buffer = readFile(path);
+            const char *end = buffer.data() + buffer.size();
+            MarketHeader header = readMarketHeader(buffer.data(), end);
+            checkField<T>(header);
+
+            MtmMat<T> result = MtmMat<T>(Dimensions(header.rows, header.cols),
+                                         T());
+            if (!header.coordinate) {
+                parseArray(header, end, result);
+                return result;
+            }
+            size_t lines = parseCoordinates<T>(
+                    header, end, [&result](size_t, size_t i, size_t j,
+                                           const T &value) {
+                        result[(index_t) i].data()[j] = value;
+                    });
+            if (lines != header.entries) {
+                throw MtmExceptions::MalformedStream();
+            }
+            return result;
+        }
+
+        /*
+         * Loads a MatrixMarket file into a sparse matrix. Coordinate files
+         * never go through dense storage, array files are dense anyway.
+         */
+        template<typename T>
+        MtmMatSparse<T> loadMatrixMarketSparse(const std::string &path) {
+            using namespace MtmLoadOps;
+            typedef typename MtmMatSparse<T>::Entry Entry;
+            std::vector<char> buffer = readFile(path);
+            const char *end = buffer.data() + buffer.size();
+            MarketHeader header = readMarketHeader(buffer.data(), end);
+            checkField<T>(header);
+            if (!header.coordinate) {
+                return MtmMatSparse<T>(loadMatrixMarket<T>(path));
+            }
+
+            //every range collects its own entries, merged at the end
+            std::vector<std::vector<Entry>> collected(rangeCount());
+            size_t lines = parseCoordinates<T>(
+                    header, end, [&collected](size_t range, size_t i,
+                                              size_t j, const T &value) {
+                        collected[range].push_back(Entry{i, j, value});
+                    });
+            if (lines != header.entries) {
+                throw MtmExceptions::MalformedStream();
+            }
+
+            std::vector<Entry> entries;
+            for (size_t k = 0; k < collected.size(); k++) {
+                entries.insert(entries.end(), collected[k].begin(),
+                               collected[k].end());
+            }
+            return MtmMatSparse<T>(Dimensions(header.rows, header.cols),
+                                   entries);
+        }
+
+    }
+}
+
+#endif //EX3_MTMLOAD_H
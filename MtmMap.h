@@ -0,0 +1,221 @@
+#ifndef EX3_MTMMAP_H
+#define EX3_MTMMAP_H
+
+#include <type_traits>
+#include <utility>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+/*
+ * Element-wise operations with user functions over one to three operands
+ * of the same shape.
+ * apply(x, ..., f) overwrites x with f(x, ...), map(x, f) and
+ * zip(a, b, [c,] f) return a new vector/matrix of f's result type.
+ * The loops run on raw storage, so f is inlined and the compiler can
+ * vectorize it, and big inputs are split between threads. f has to be
+ * safe to call concurrently.
+ * apply leaves the elements x forbids (outside the triangle of an
+ * MtmMatTriag) untouched, checking permissions only in rows that have
+ * them; map and zip read those elements like any other.
+ */
+
+namespace MtmMath {
+
+    //below this many elements a map stays on the calling thread
+    const size_t MAP_PARALLEL_THRESHOLD = 1 << 15;
+
+    namespace MtmMapOps {
+
+        template<typename R, typename F, typename... In>
+        void mapArray(size_t first, size_t last, R *out, F &f,
+                      const In *... in) {
+            for (size_t i = first; i < last; i++) {
+                out[i] = f(in[i]...);
+            }
+        }
+
+        /*
+         * mapArray into out, skipping the elements out forbids
+         */
+        template<typename R, typename F, typename... In>
+        void mapAllowed(size_t first, size_t last, MtmVec<R> &out, F &f,
+                        const In *... in) {
+            if (out.allAllowed()) {
+                mapArray(first, last, out.data(), f, in...);
+                return;
+            }
+            R *data = out.data();
+            for (size_t i = first; i < last; i++) {
+                if (out.isAllowed(i)) {
+                    data[i] = f(in[i]...);
+                }
+            }
+        }
+
+        template<typename R, typename F, typename... In>
+        void mapVector(MtmVec<R> &out, F &f, const In *... in) {
+            size_t n = out.size();
+            MTM_STATS_OPERATION(ELEMENTWISE_MAP, n);
+            if (n < MAP_PARALLEL_THRESHOLD) {
+                mapAllowed(0, n, out, f, in...);
+                return;
+            }
+            MtmScheduler::parallelFor(
+                    0, n, MAP_PARALLEL_THRESHOLD / 4,
+                    [&](size_t first, size_t last) {
+                        mapAllowed(first, last, out, f, in...);
+                    });
+        }
+
+        template<typename R, typename F, typename... In>
+        void mapMatrix(MtmMat<R> &out, F &f, const MtmMat<In> &... in) {
+            size_t rows = (size_t) out.getDimensions().getRow();
+            size_t cols = (size_t) out.getDimensions().getCol();
+            MTM_STATS_OPERATION(ELEMENTWISE_MAP, rows * cols);
+            auto rowsBody = [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++) {
+                    mapAllowed(0, cols, out[(index_t) i], f,
+                               in[(index_t) i].data()...);
+                }
+            };
+            if (rows * cols < MAP_PARALLEL_THRESHOLD) {
+                rowsBody(0, rows);
+                return;
+            }
+            MtmScheduler::placedFor(0, rows,
+                                    MAP_PARALLEL_THRESHOLD / 4 / cols + 1,
+                                    rowsBody);
+        }
+
+        template<typename A, typename B>
+        void checkShape(const A &a, const B &b) {
+            if (a.getDimensions() != b.getDimensions()) {
+                throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                       b.getDimensions());
+            }
+        }
+
+        template<typename R>
+        MtmVec<R> vectorLike(const Dimensions &dim) {
+            bool isRow = dim.getRow() == 1 && dim.getCol() != 1;
+            MtmVec<R> result = MtmVec<R>(
+                    (size_t) (isRow ? dim.getCol() : dim.getRow()), R());
+            if (isRow) {
+                result.transpose();
+            }
+            return result;
+        }
+
+        template<typename F, typename... In>
+        using Result = typename std::decay<decltype(std::declval<F &>()(
+                std::declval<const In &>()...))>::type;
+    }
+
+    //VECTORS
+
+    template<typename T, typename F>
+    void apply(MtmVec<T> &x, F f) {
+        MtmMapOps::mapVector(x, f, (const T *) x.data());
+    }
+
+    template<typename T, typename A, typename F>
+    void apply(MtmVec<T> &x, const MtmVec<A> &a, F f) {
+        MtmMapOps::checkShape(x, a);
+        MtmMapOps::mapVector(x, f, (const T *) x.data(), a.data());
+    }
+
+    template<typename T, typename A, typename B, typename F>
+    void apply(MtmVec<T> &x, const MtmVec<A> &a, const MtmVec<B> &b, F f) {
+        MtmMapOps::checkShape(x, a);
+        MtmMapOps::checkShape(x, b);
+        MtmMapOps::mapVector(x, f, (const T *) x.data(), a.data(),
+                             b.data());
+    }
+
+    template<typename T, typename F>
+    MtmVec<MtmMapOps::Result<F, T>>
+    map(const MtmVec<T> &x, F f) {
+        typedef MtmMapOps::Result<F, T> R;
+        MtmVec<R> result = MtmMapOps::vectorLike<R>(x.getDimensions());
+        MtmMapOps::mapVector(result, f, x.data());
+        return result;
+    }
+
+    template<typename A, typename B, typename F>
+    MtmVec<MtmMapOps::Result<F, A, B>>
+    zip(const MtmVec<A> &a, const MtmVec<B> &b, F f) {
+        typedef MtmMapOps::Result<F, A, B> R;
+        MtmMapOps::checkShape(a, b);
+        MtmVec<R> result = MtmMapOps::vectorLike<R>(a.getDimensions());
+        MtmMapOps::mapVector(result, f, a.data(), b.data());
+        return result;
+    }
+
+    template<typename A, typename B, typename C, typename F>
+    MtmVec<MtmMapOps::Result<F, A, B, C>>
+    zip(const MtmVec<A> &a, const MtmVec<B> &b, const MtmVec<C> &c, F f) {
+        typedef MtmMapOps::Result<F, A, B, C> R;
+        MtmMapOps::checkShape(a, b);
+        MtmMapOps::checkShape(a, c);
+        MtmVec<R> result = MtmMapOps::vectorLike<R>(a.getDimensions());
+        MtmMapOps::mapVector(result, f, a.data(), b.data(), c.data());
+        return result;
+    }
+
+    //MATRICES
+
+    template<typename T, typename F>
+    void apply(MtmMat<T> &x, F f) {
+        MtmMapOps::mapMatrix(x, f, (const MtmMat<T> &) x);
+    }
+
+    template<typename T, typename A, typename F>
+    void apply(MtmMat<T> &x, const MtmMat<A> &a, F f) {
+        MtmMapOps::checkShape(x, a);
+        MtmMapOps::mapMatrix(x, f, (const MtmMat<T> &) x, a);
+    }
+
+    template<typename T, typename A, typename B, typename F>
+    void apply(MtmMat<T> &x, const MtmMat<A> &a, const MtmMat<B> &b, F f) {
+        MtmMapOps::checkShape(x, a);
+        MtmMapOps::checkShape(x, b);
+        MtmMapOps::mapMatrix(x, f, (const MtmMat<T> &) x, a, b);
+    }
+
+    template<typename T, typename F>
+    MtmMat<MtmMapOps::Result<F, T>>
+    map(const MtmMat<T> &x, F f) {
+        typedef MtmMapOps::Result<F, T> R;
+        MtmMat<R> result = MtmMat<R>(x.getDimensions(), R());
+        MtmMapOps::mapMatrix(result, f, x);
+        return result;
+    }
+
+    template<typename A, typename B, typename F>
+    MtmMat<MtmMapOps::Result<F, A, B>>
+    zip(const MtmMat<A> &a, const MtmMat<B> &b, F f) {
+        typedef MtmMapOps::Result<F, A, B> R;
+        MtmMapOps::checkShape(a, b);
+        MtmMat<R> result = MtmMat<R>(a.getDimensions(), R());
+        MtmMapOps::mapMatrix(result, f, a, b);
+        return result;
+    }
+
+    template<typename A, typename B, typename C, typename F>
+    MtmMat<MtmMapOps::Result<F, A, B, C>>
+    zip(const MtmMat<A> &a, const MtmMat<B> &b, const MtmMat<C> &c, F f) {
+        typedef MtmMapOps::Result<F, A, B, C> R;
+        MtmMapOps::checkShape(a, b);
+        MtmMapOps::checkShape(a, c);
+        MtmMat<R> result = MtmMat<R>(a.getDimensions(), R());
+        MtmMapOps::mapMatrix(result, f, a, b, c);
+        return result;
+    }
+
+}
+
+#endif //EX3_MTMMAP_H
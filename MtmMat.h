@@ -5,7 +5,10 @@
 #include "MtmExceptions.h"
 #include "Auxilaries.h"
 #include "MtmVec.h"
+#include "MtmKernels.h"
+#include "MtmScheduler.h"
 #include "cmath"
+#include <functional>
 
 using std::size_t;
 
@@ -13,90 +16,172 @@ namespace MtmMath {
 
     //MAT ITERATOR CLASS
 
+    /*
+     * Random access iterator over the matrix elements in column major order
+     * (down a column, then on to the next one). T is const for the
+     * const_iterator. The position is kept as (row, col) so stepping is a
+     * compare and an increment; jumps go through the linear index
+     * col * rows + row. Reads and writes to rows without restrictions
+     * go straight to the storage; writes into a row with forbidden
+     * elements (triangular matrices) go through the checked
+     * MtmVec::operator[] and throw AccessIllegalElement.
+     */
     template<typename T>
     class MatIterator {
-        MtmVec <T> *ptr;
-        Dimensions matDimensions;
-        Dimensions iteratorLocation;
+        typedef typename std::remove_const<T>::type Element;
+        typedef typename std::conditional<std::is_const<T>::value,
+                const MtmVec<Element>, MtmVec<Element>>::type Row;
 
-    public:
+        Row *rows;
+        std::ptrdiff_t rowCount;
+        std::ptrdiff_t row;
+        std::ptrdiff_t col;
 
-        MatIterator(MtmVec <T> *ptr = NULL,
-                    Dimensions matDimensions_t = Dimensions(),
-                    Dimensions iteratorLocation_t = Dimensions()) : ptr(ptr) {
-            matDimensions = matDimensions_t;
-            iteratorLocation = iteratorLocation_t;
+        template<typename S>
+        friend class MatIterator;
+
+        std::ptrdiff_t index() const {
+            return col * rowCount + row;
         }
 
-        MatIterator(const MatIterator &toCopy) = default;
+        void setIndex(std::ptrdiff_t linear) {
+            col = linear / rowCount;
+            row = linear % rowCount;
+        }
 
-        ~MatIterator() = default;
+        T &element(std::true_type) const {
+            return rows[row].data()[col];
+        }
 
-        bool operator==(const MatIterator &toCompare) const;
+        T &element(std::false_type) const {
+            Row &current = rows[row];
+            if (!current.allAllowed()) {
+                return current[(index_t) col];
+            }
+            return current.data()[col];
+        }
 
-        bool operator!=(const MatIterator &toCompare) const;
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef Element value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T *pointer;
+        typedef T &reference;
+
+        MatIterator(Row *rows_t = NULL, std::ptrdiff_t rowCount_t = 1,
+                    std::ptrdiff_t linear = 0) : rows(rows_t),
+                                                 rowCount(rowCount_t),
+                                                 row(0), col(0) {
+            setIndex(linear);
+        }
 
-        T &operator*();
+        MatIterator(const MatIterator &toCopy) = default;
 
-        MatIterator &operator=(const MatIterator &c);
+        //iterator -> const_iterator
+        template<typename S, typename = typename std::enable_if<
+                std::is_same<const S, T>::value>::type>
+        MatIterator(const MatIterator<S> &toConvert)
+                : rows(toConvert.rows), rowCount(toConvert.rowCount),
+                  row(toConvert.row), col(toConvert.col) {}
 
-        MatIterator operator++();
-    };
+        ~MatIterator() = default;
 
-    template<typename T>
-    MatIterator<T> MatIterator<T>::operator++() {
-        //get mat dimensions, and iterator location
-        int matColumns = this->matDimensions.getCol();
-        int matRows = this->matDimensions.getRow();
-        int rowLocation = this->iteratorLocation.getRow();
-        int colLocation = this->iteratorLocation.getCol();
+        MatIterator &operator=(const MatIterator &c) = default;
 
-        ++(ptr);
-        rowLocation++;
-        this->iteratorLocation.setRow(rowLocation);
+        T &operator*() const {
+            return element(std::is_const<T>());
+        }
 
-        if (rowLocation == matRows) {
+        T *operator->() const {
+            return &(**this);
+        }
 
-            colLocation++;
-            this->iteratorLocation.setCol(colLocation);
+        T &operator[](difference_type n) const {
+            return *(*this + n);
+        }
 
-            if (colLocation == matColumns) {
-                --(ptr);
-                rowLocation--;
-                this->iteratorLocation.setRow(rowLocation);
-            } else {
-                ptr = ptr - matRows;
-                this->iteratorLocation.setRow(0);
+        MatIterator &operator++() {
+            if (++row == rowCount) {
+                row = 0;
+                ++col;
             }
+            return *this;
         }
-        return *this;
-    }
 
-    template<typename T>
-    T &MatIterator<T>::operator*() {
-        return (((*ptr))[iteratorLocation.getCol()]);
-    }
+        MatIterator operator++(int) {
+            MatIterator result = *this;
+            ++(*this);
+            return result;
+        }
 
-    template<typename T>
-    bool MatIterator<T>::operator==(const MatIterator &toCompare) const {
-        return (ptr == toCompare.ptr &&
-                iteratorLocation == toCompare.iteratorLocation);
-    }
+        MatIterator &operator--() {
+            if (row-- == 0) {
+                row = rowCount - 1;
+                --col;
+            }
+            return *this;
+        }
 
-    template<typename T>
-    bool MatIterator<T>::operator!=(const MatIterator &toCompare) const {
-        return !(operator==(toCompare));
-    }
+        MatIterator operator--(int) {
+            MatIterator result = *this;
+            --(*this);
+            return result;
+        }
 
-    template<typename T>
-    MatIterator<T> &MatIterator<T>::operator=(const MatIterator<T> &c) {
-        if (this == &c) {
+        MatIterator &operator+=(difference_type n) {
+            setIndex(index() + n);
             return *this;
         }
-        ptr = c.ptr;
-        iteratorLocation = c.iteratorLocation;
-        matDimensions = c.matDimensions;
-        return *this;
+
+        MatIterator &operator-=(difference_type n) {
+            setIndex(index() - n);
+            return *this;
+        }
+
+        MatIterator operator+(difference_type n) const {
+            MatIterator result = *this;
+            return result += n;
+        }
+
+        MatIterator operator-(difference_type n) const {
+            MatIterator result = *this;
+            return result -= n;
+        }
+
+        difference_type operator-(const MatIterator &other) const {
+            return index() - other.index();
+        }
+
+        bool operator==(const MatIterator &toCompare) const {
+            return rows == toCompare.rows && row == toCompare.row &&
+                   col == toCompare.col;
+        }
+
+        bool operator!=(const MatIterator &toCompare) const {
+            return !(operator==(toCompare));
+        }
+
+        bool operator<(const MatIterator &toCompare) const {
+            return index() < toCompare.index();
+        }
+
+        bool operator>(const MatIterator &toCompare) const {
+            return index() > toCompare.index();
+        }
+
+        bool operator<=(const MatIterator &toCompare) const {
+            return index() <= toCompare.index();
+        }
+
+        bool operator>=(const MatIterator &toCompare) const {
+            return index() >= toCompare.index();
+        }
+    };
+
+    template<typename T>
+    MatIterator<T> operator+(typename MatIterator<T>::difference_type n,
+                             const MatIterator<T> &it) {
+        return it + n;
     }
 
 
@@ -137,10 +222,10 @@ namespace MtmMath {
     template<typename T>
     MatNonZeroIterator<T> MatNonZeroIterator<T>::operator++() {
         //get mat dimensions, and iterator location
-        int matColumns = this->matDimensions.getCol();
-        int matRows = this->matDimensions.getRow();
-        int rowLocation = this->iteratorLocation.getRow();
-        int colLocation = this->iteratorLocation.getCol();
+        index_t matColumns = this->matDimensions.getCol();
+        index_t matRows = this->matDimensions.getRow();
+        index_t rowLocation = this->iteratorLocation.getRow();
+        index_t colLocation = this->iteratorLocation.getCol();
 
         ++(ptr);
         rowLocation++;
@@ -212,6 +297,7 @@ namespace MtmMath {
     public:
 
     typedef MatIterator<T> iterator;
+    typedef MatIterator<const T> const_iterator;
     typedef MatNonZeroIterator<T> nonzero_iterator;
 
     /* Vector Constructor -
@@ -231,9 +317,26 @@ namespace MtmMath {
 
         MtmVec<T> defVec = MtmVec<T>((size_t) dim_t.getCol(), val);
         defVec.transpose();
-        MtmVec<MtmVec<T>> newShape = MtmVec<MtmVec<T>>((size_t) dim_t.getRow(),
-                                                       defVec);
-        (*this) = newShape;
+        size_t rows = (size_t) dim_t.getRow();
+        size_t cols = (size_t) dim_t.getCol();
+        if (MtmScheduler::numaPolicy() == MtmScheduler::NUMA_OFF ||
+            rows * cols < MtmScheduler::NUMA_PLACEMENT_THRESHOLD) {
+            MtmVec<MtmVec<T>>::operator=(MtmVec<MtmVec<T>>(rows, defVec));
+        } else {
+            //every row is allocated and first written by its worker
+            MtmVec<MtmVec<T>> newShape = MtmVec<MtmVec<T>>(rows,
+                                                           MtmVec<T>());
+            MtmVec<T> *rowData = newShape.data();
+            MtmScheduler::placedFor(0, rows, 0,
+                                    [rowData, &defVec](size_t first,
+                                                       size_t last) {
+                                        for (size_t i = first; i < last;
+                                             i++) {
+                                            rowData[i] = defVec;
+                                        }
+                                    });
+            MtmVec<MtmVec<T>>::operator=(std::move(newShape));
+        }
         this->objectDimensions = dim_t;
     }
 
@@ -241,14 +344,16 @@ namespace MtmMath {
 
     MtmMat(const MtmMat<T> &toCopy) = default;
 
+    MtmMat(MtmMat<T> &&toMove) = default;
+
     MtmMat(const MtmVec <T> &toConvert) {
         MtmMat < T > vecToMat = MtmMat(toConvert.getDimensions(), T());
-        if (toConvert.getDimensions().getCol == 1) {
-            for (int i = 0; i < vecToMat.getDimensions.getRow(); i++) {
+        if (toConvert.getDimensions().getCol() == 1) {
+            for (index_t i = 0; i < vecToMat.getDimensions().getRow(); i++) {
                 vecToMat[i][0] = toConvert[i];
             }
         } else {
-            for (int i = 0; i < vecToMat.getDimensions.getCol(); i++) {
+            for (index_t i = 0; i < vecToMat.getDimensions().getCol(); i++) {
                 vecToMat[0][i] = toConvert[i];
             }
         }
@@ -257,15 +362,15 @@ namespace MtmMath {
 
     MtmMat(const MtmVec <MtmVec<T>> &toConvert) {
         MtmMat < T > vecToMat = MtmMat(toConvert.getDimensions(), T());
-        for (int i = 0; i < toConvert.getDimensions().getRow(); i++) {
-            for (int j = 0; j < toConvert.getDimensions().getCol(); j++) {
+        for (index_t i = 0; i < toConvert.getDimensions().getRow(); i++) {
+            for (index_t j = 0; j < toConvert.getDimensions().getCol(); j++) {
                 vecToMat[i][j] = toConvert[i][j];
             }
         }
         (*this) = vecToMat;
     }
 
-    static int min(const int &a, const int &b) {
+    static index_t min(const index_t &a, const index_t &b) {
         if (a < b) {
             return a;
         }
@@ -278,7 +383,7 @@ namespace MtmMath {
     MtmVec<MtmVec < T>>
     ::allowAllVec();
     for (
-    int i = 0;
+    index_t i = 0;
 i < this->objectDimensions.
 
     getRow();
@@ -291,7 +396,13 @@ i < this->objectDimensions.
 }
 
 MtmMat &operator+=(const MtmMat <T> &c) {
-    for (int i = 0; i < this->objectDimensions.getRow(); i++) {
+    if (this->objectDimensions != c.getDimensions()) {
+        throw MtmExceptions::DimensionMismatch(this->getDimensions(),
+                                               c.getDimensions());
+    }
+    MTM_STATS_OPERATION(MAT_ADD, this->objectDimensions.getRow() *
+                                 this->objectDimensions.getCol());
+    for (index_t i = 0; i < this->objectDimensions.getRow(); i++) {
         (*this)[i] += c[i];
     }
     return *this;
@@ -304,24 +415,42 @@ MtmMat &operator=(const MtmMat <T> &c) {
     return *this;
 }
 
+MtmMat &operator=(MtmMat <T> &&c) noexcept {
+    MtmVec < MtmVec < T >> ::operator=(std::move(c));
+    return *this;
+}
+
 MtmMat &operator=(const MtmVec <MtmVec<T>> &c) {
     MtmVec < MtmVec < T >> ::operator=(c);
     return *this;
 }
 
 
-MtmMat &operator-=(const MtmMat &c) {
-    operator+=(-(c));
+MtmMat &operator-=(const MtmMat <T> &c) {
+    if (this->objectDimensions != c.getDimensions()) {
+        throw MtmExceptions::DimensionMismatch(this->getDimensions(),
+                                               c.getDimensions());
+    }
+    MTM_STATS_OPERATION(MAT_ADD, this->objectDimensions.getRow() *
+                                 this->objectDimensions.getCol());
+    for (index_t i = 0; i < this->objectDimensions.getRow(); i++) {
+        (*this)[i] -= c[i];
+    }
+    return *this;
 }
 
 MtmMat &operator*=(const MtmMat &c) {
-    MtmMat <T> result = (*this) * c;
-    (*this) = result;
+    *this = (*this) * c;
+    return *this;
 }
 
 MtmMat &operator+=(const T &c) {
-    for (int i = 0; i < this->objectDimensions.getRow(); i++) {
-        (*this)[i] += c;
+    MTM_STATS_OPERATION(MAT_SCALAR_ADD, this->objectDimensions.getRow() *
+                                        this->objectDimensions.getCol());
+    //c may be one of the elements
+    const T value = c;
+    for (index_t i = 0; i < this->objectDimensions.getRow(); i++) {
+        (*this)[i] += value;
     }
     return *this;
 }
@@ -331,23 +460,53 @@ MtmMat &operator-=(const T &c) {
 }
 
 MtmMat &operator*=(const T &c) {
-    MtmMat <T> result = MtmMat<T>(*this);
-    for (int i = 0; i < result.getDimensions.getRow(); i++) {
-        result[i] = (*this)[i] * c;
+    MTM_STATS_OPERATION(MAT_SCALE, this->objectDimensions.getRow() *
+                                   this->objectDimensions.getCol());
+    //c may be one of the elements
+    const T value = c;
+    for (index_t i = 0; i < this->objectDimensions.getRow(); i++) {
+        (*this)[i] *= value;
     }
-    (*this) = result;
+    return *this;
 }
 
 
-MtmVec <T> getColVector(int col) const {
+/*
+ * Sets every element the matrix allows writing to val. Big matrices are
+ * written by the workers the NUMA policy places their rows on.
+ */
+void fill(const T &val) {
+    size_t rows = (size_t) this->objectDimensions.getRow();
+    size_t cols = (size_t) this->objectDimensions.getCol();
+    MtmVec <T> *rowData = this->data();
+    MtmScheduler::placedFor(
+            0, rows, MtmScheduler::NUMA_PLACEMENT_THRESHOLD / cols + 1,
+            [rowData, cols, &val](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++) {
+                    T *row = rowData[i].data();
+                    if (rowData[i].allAllowed()) {
+                        std::fill(row, row + cols, val);
+                        continue;
+                    }
+                    for (size_t j = 0; j < cols; j++) {
+                        if (rowData[i].isAllowed(j)) {
+                            row[j] = val;
+                        }
+                    }
+                }
+            });
+}
+
+MtmVec <T> getColVector(index_t col) const {
     if (col >= this->objectDimensions.getCol()) {
         throw MtmExceptions::IllegalInitialization();
     }
+    MTM_STATS_OPERATION(MAT_GET_COL_VECTOR, 0);
 
     MtmVec <T>
             colVector = MtmVec<T>(this->objectDimensions.getRow(),
                                   T());
-    for (int i = 0; i < this->objectDimensions.getRow(); i++) {
+    for (index_t i = 0; i < this->objectDimensions.getRow(); i++) {
         colVector[i] = (*this)[i][col];
     }
 
@@ -366,9 +525,34 @@ MtmVec <T> matFunc(Func &f) const;
 
 /*
  * resizes a matrix to dimension dim, new elements gets the value val.
+ * Works in place, the kept elements are not copied.
  */
 virtual void resize(Dimensions dim, const T &val);
 
+/*
+ * Adds row (a row or column vector with one element per column) as the
+ * new last row. Row storage grows geometrically, so appending costs
+ * amortized O(cols).
+ */
+virtual void appendRow(const MtmVec <T> &row);
+
+/*
+ * Adds col (one element per row) as the new last column, amortized
+ * O(rows)
+ */
+virtual void appendCol(const MtmVec <T> &col);
+
+/*
+ * Makes room for capacity rows, and for capacity columns in the rows
+ * that exist now, so appends up to that size do not reallocate
+ */
+void reserve(Dimensions capacity);
+
+/*
+ * Returns the memory held beyond the current dimensions
+ */
+void shrink_to_fit();
+
 /*
  * reshapes matrix so linear elements value are the same without
  * changing num of elements.
@@ -392,8 +576,8 @@ nonzero_iterator nzend() {
 }
 
 nonzero_iterator nzbegin() {
-    for (int j = 0; j < (*this).getDimensions().getCol(); j++) {
-        for (int i = 0; i < (*this).getDimensions().getRow(); i++) {
+    for (index_t j = 0; j < (*this).getDimensions().getCol(); j++) {
+        for (index_t i = 0; i < (*this).getDimensions().getRow(); i++) {
             if ((*this)[i][j] != 0) {
                 return nonzero_iterator(&((*this)[i]), this->getDimensions(),
                                         Dimensions(i, j));
@@ -405,15 +589,31 @@ nonzero_iterator nzbegin() {
 }
 
 iterator end() {
-    return iterator(&(*this)[this->getDimensions().getRow() - 1],
-                    this->getDimensions(),
-                    Dimensions(this->getDimensions().getRow() - 1,
-                               this->getDimensions().getCol()));
+    return iterator(this->data(), this->getDimensions().getRow(),
+                    (std::ptrdiff_t) this->getDimensions().getRow() *
+                    this->getDimensions().getCol());
 }
 
 iterator begin() {
-    return iterator(&((*this)[0]), this->getDimensions(),
-                    Dimensions(0, 0));
+    return iterator(this->data(), this->getDimensions().getRow(), 0);
+}
+
+const_iterator end() const {
+    return const_iterator(this->data(), this->getDimensions().getRow(),
+                          (std::ptrdiff_t) this->getDimensions().getRow() *
+                          this->getDimensions().getCol());
+}
+
+const_iterator begin() const {
+    return const_iterator(this->data(), this->getDimensions().getRow(), 0);
+}
+
+const_iterator cend() const {
+    return end();
+}
+
+const_iterator cbegin() const {
+    return begin();
 }
 
 };
@@ -424,12 +624,30 @@ MtmMat <T> operator*(const T &num, const MtmMat <T> &a);
 
 template<typename T>
 MtmMat <T> operator*(const T &num, const MtmMat <T> &a) {
+    MTM_STATS_OPERATION(MAT_SCALE, a.getDimensions().getRow() *
+                                   a.getDimensions().getCol());
     MtmMat <T> result = MtmMat<T>(a);
-    for (int i = 0; i < a.getDimensions().getRow(); i++) {
+    for (index_t i = 0; i < a.getDimensions().getRow(); i++) {
         result[i] = a[i] * num;
     }
 
-    return MtmMat<T>(result);
+    return result;
+}
+
+/*
+ * Elementwise sum and difference, counted once as MAT_ADD instead of
+ * through the row vector operators
+ */
+template<typename T>
+MtmMat <T> operator+(const MtmMat <T> &a, const MtmMat <T> &b) {
+    MtmMat <T> result = MtmMat<T>(a);
+    return result += b;
+}
+
+template<typename T>
+MtmMat <T> operator-(const MtmMat <T> &a, const MtmMat <T> &b) {
+    MtmMat <T> result = MtmMat<T>(a);
+    return result -= b;
 }
 
 template<typename T>
@@ -451,12 +669,14 @@ MtmMat <T> operator-(const T &num, const MtmMat <T> &a) {
 
 template<typename T>
 MtmMat <T> operator+(const T &num, const MtmMat <T> &a) {
+    MTM_STATS_OPERATION(MAT_SCALAR_ADD, a.getDimensions().getRow() *
+                                        a.getDimensions().getCol());
     MtmMat <T> result = MtmMat<T>(a);
-    for (int i = 0; i < a.getDimensions().getRow(); i++) {
+    for (index_t i = 0; i < a.getDimensions().getRow(); i++) {
         result[i] = a[i] + num;
     }
 
-    return MtmMat<T>(result);
+    return result;
 }
 
 
@@ -465,28 +685,187 @@ MtmMat <T> operator+(const MtmMat <T> &a, const T &num) {
     return num + a;
 }
 
+/*
+ * c = a * b into an existing matrix of the right dimensions, so repeated
+ * products (powers, polynomials) can reuse their buffers. c may be a or
+ * b, then one temporary is made. Blocks of rows of c are split between
+ * threads for big products. Element types with a faster exact kernel
+ * overload multiplyInto in their own namespace (found by ADL).
+ */
 template<typename T>
-MtmMat <T> operator*(const MtmMat <T> &a, const MtmMat <T> &b) {
+void multiplyInto(const MtmMat <T> &a, const MtmMat <T> &b, MtmMat <T> &c) {
     if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
         throw MtmExceptions::DimensionMismatch(a.getDimensions(),
                                                b.getDimensions());
     }
-
     Dimensions resultDimensions =
             Dimensions(a.getDimensions().getRow(),
                        b.getDimensions().getCol());
-    MtmMat <T> result = MtmMat<T>(resultDimensions, T());
-    for (int i = 0; i < result.getDimensions().getRow(); i++) {
-        for (int j = 0; j < result.getDimensions().getCol(); j++) {
-            MtmVec <T> oneOnOne = a[i] * (b.getColVector(j));
-            ((result)[i])[j] = oneOnOne[0];
+    if (c.getDimensions() != resultDimensions) {
+        throw MtmExceptions::DimensionMismatch(resultDimensions,
+                                               c.getDimensions());
+    }
+    if (&c == &a || &c == &b) {
+        MtmMat <T> result = MtmMat<T>(resultDimensions, T());
+        multiplyInto(a, b, result);
+        c = std::move(result);
+        return;
+    }
+
+    size_t m = (size_t) a.getDimensions().getRow();
+    size_t n = (size_t) b.getDimensions().getCol();
+    size_t k = (size_t) a.getDimensions().getCol();
+    MTM_STATS_OPERATION(MAT_MULTIPLY, 2ULL * m * n * k);
+
+    auto rowsBody = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            std::fill(c[(index_t) i].begin(), c[(index_t) i].end(), T());
         }
+        MtmKernels::gemmBlocked<T>(
+                last - first, n, k,
+                [&a, first](size_t i) { return a[(index_t) (first + i)].data(); },
+                MtmKernels::MatRows<const MtmMat<T>, const T>(b),
+                [&c, first](size_t i) { return c[(index_t) (first + i)].data(); });
+    };
+    if (m * n * k < MtmKernels::GEMM_PARALLEL_THRESHOLD) {
+        rowsBody(0, m);
+    } else {
+        MtmScheduler::placedFor(0, m, MtmKernels::GEMM_BLOCK_ROWS, rowsBody);
     }
+}
+
+template<typename T>
+MtmMat <T> operator*(const MtmMat <T> &a, const MtmMat <T> &b) {
+    MtmMat <T> result = MtmMat<T>(
+            Dimensions(a.getDimensions().getRow(),
+                       b.getDimensions().getCol()), T());
+    multiplyInto(a, b, result);
+    return result;
+}
 
-    return (MtmMat<T>(result));
+/*
+ * Matrix times column vector, gives a column vector. Works on the row
+ * storage directly and splits the rows between threads for big matrices.
+ */
+template<typename T>
+MtmVec <T> operator*(const MtmMat <T> &a, const MtmVec <T> &x) {
+    if (x.getDimensions() !=
+        Dimensions((size_t) a.getDimensions().getCol(), 1)) {
+        throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                               x.getDimensions());
+    }
 
+    size_t m = (size_t) a.getDimensions().getRow();
+    size_t n = (size_t) a.getDimensions().getCol();
+    MTM_STATS_OPERATION(MAT_VEC_MULTIPLY, 2 * m * n);
+
+    MtmVec <T> result = MtmVec<T>(m, T());
+    MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+    const T *in = x.data();
+    T *out = result.data();
+    if (m * n < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+        MtmKernels::gemvRows(0, m, n, aRow, in, out);
+        return result;
+    }
+    MtmScheduler::placedFor(
+            0, m, MtmKernels::GEMV_PARALLEL_THRESHOLD / n + 1,
+            [&](size_t first, size_t last) {
+                MtmKernels::gemvRows(first, last, n, aRow, in, out);
+            });
+    return result;
 }
 
+/*
+ * Row vector times matrix, gives a row vector. Threads split the output
+ * columns, so every thread still streams through whole rows.
+ */
+template<typename T>
+MtmVec <T> operator*(const MtmVec <T> &x, const MtmMat <T> &a) {
+    if (x.getDimensions() !=
+        Dimensions(1, (size_t) a.getDimensions().getRow())) {
+        throw MtmExceptions::DimensionMismatch(x.getDimensions(),
+                                               a.getDimensions());
+    }
+
+    size_t m = (size_t) a.getDimensions().getRow();
+    size_t n = (size_t) a.getDimensions().getCol();
+    MTM_STATS_OPERATION(VEC_MAT_MULTIPLY, 2 * m * n);
+
+    MtmVec <T> result = MtmVec<T>(n, T());
+    result.transpose();
+    MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+    const T *in = x.data();
+    T *out = result.data();
+    if (m * n < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+        MtmKernels::gemvTransCols(0, n, m, aRow, in, out);
+        return result;
+    }
+    MtmScheduler::parallelFor(
+            0, n, MtmKernels::GEMV_PARALLEL_THRESHOLD / m + 1,
+            [&](size_t first, size_t last) {
+                MtmKernels::gemvTransCols(first, last, m, aRow, in, out);
+            });
+    return result;
+}
+
+/*
+ * Complex matrix product using the 3M method - three real GEMMs on split
+ * real/imaginary planes instead of four real multiplies per element.
+ * Results may differ from operator* in the last bits of the imaginary part.
+ * Define MTM_COMPLEX_3M to make operator* on MtmMat<Complex> use it.
+ */
+inline MtmMat <Complex> multiply3M(const MtmMat <Complex> &a,
+                                   const MtmMat <Complex> &b) {
+    if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
+        throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                               b.getDimensions());
+    }
+
+    size_t m = (size_t) a.getDimensions().getRow();
+    size_t k = (size_t) a.getDimensions().getCol();
+    size_t n = (size_t) b.getDimensions().getCol();
+    //three real GEMMs plus the plane additions
+    MTM_STATS_OPERATION(MAT_MULTIPLY_3M,
+                        6ULL * m * n * k + m * k + k * n + 3ULL * m * n);
+
+    std::vector<double> ar(m * k), ai(m * k), br(k * n), bi(k * n);
+    for (size_t i = 0; i < m; i++) {
+        for (size_t p = 0; p < k; p++) {
+            ar[i * k + p] = a[(index_t) i][(index_t) p].getReal();
+            ai[i * k + p] = a[(index_t) i][(index_t) p].getImag();
+        }
+    }
+    for (size_t p = 0; p < k; p++) {
+        for (size_t j = 0; j < n; j++) {
+            br[p * n + j] = b[(index_t) p][(index_t) j].getReal();
+            bi[p * n + j] = b[(index_t) p][(index_t) j].getImag();
+        }
+    }
+
+    std::vector<double> cr, ci;
+    MtmKernels::gemm3M(m, n, k, ar, ai, br, bi, cr, ci);
+
+    MtmMat <Complex> result = MtmMat<Complex>(
+            Dimensions(m, n), Complex());
+    for (size_t i = 0; i < m; i++) {
+        Complex *row = result[(index_t) i].data();
+        for (size_t j = 0; j < n; j++) {
+            row[j] = Complex(cr[i * n + j], ci[i * n + j]);
+        }
+    }
+
+    return result;
+}
+
+#ifdef MTM_COMPLEX_3M
+
+inline MtmMat <Complex> operator*(const MtmMat <Complex> &a,
+                                  const MtmMat <Complex> &b) {
+    return multiply3M(a, b);
+}
+
+#endif
+
 
 template<typename T>
 template<typename Func>
@@ -496,7 +875,7 @@ MtmVec <T> MtmMat<T>::matFunc(Func &f) const {
 
     MtmMat <T> temp = *this;
     temp.transpose();
-    for (int i = 0; i < temp.objectDimensions.getRow(); i++) {
+    for (index_t i = 0; i < temp.objectDimensions.getRow(); i++) {
         MtmVec <T> tempVec = temp[i];
         result[i] = tempVec.vecFunc(f);
     }
@@ -511,37 +890,126 @@ void MtmMat<T>::resize(Dimensions dim, const T &val) try {
     if (!dim.getCol() || !dim.getRow()) {
         throw MtmExceptions::ChangeMatFail(this->getDimensions(), dim);
     }
+    MTM_STATS_OPERATION(MAT_RESIZE, 0);
 
     (*this).allowAllVec();
 
-    MtmMat <T> newSize = MtmMat<T>(dim, val);
-    for (int i = 0;
-         i < min(dim.getRow(), this->objectDimensions.getRow()); i++) {
-        for (int j = 0;
-             j < min(dim.getCol(), this->objectDimensions.getCol()); j++) {
-            newSize[i][j] = (*this)[i][j];
+    size_t rows = (size_t) dim.getRow();
+    size_t oldRows = (size_t) this->objectDimensions.getRow();
+    if (rows < oldRows) {
+        MTM_STATS_RELEASE((oldRows - rows) * sizeof(MtmVec < T > ));
+        MtmVec<MtmVec<T>>::Storage::resize(rows);
+    }
+    if ((size_t) dim.getCol() != (size_t) this->objectDimensions.getCol()) {
+        for (size_t i = 0; i < std::min(rows, oldRows); i++) {
+            this->data()[i].MtmVec<T>::resize(Dimensions(1, dim.getCol()),
+                                              val);
+        }
+    }
+    this->objectDimensions = Dimensions(std::min(rows, oldRows),
+                                        dim.getCol());
+    if (rows > oldRows) {
+        this->reserve(Dimensions(rows, dim.getCol()));
+        MtmVec <T> newRow = MtmVec<T>((size_t) dim.getCol(), val);
+        newRow.transpose();
+        for (size_t i = oldRows; i < rows; i++) {
+            MtmMat<T>::appendRow(newRow);
         }
     }
-    (*this) = newSize;
 }
 catch (std::bad_alloc &e) {
     throw MtmMath::MtmExceptions::OutOfMemory();
 }
 
+template<typename T>
+void MtmMat<T>::appendRow(const MtmVec <T> &row) try {
+    size_t cols = (size_t) this->objectDimensions.getCol();
+    if (row.size() != cols) {
+        throw MtmExceptions::DimensionMismatch(Dimensions(1, cols),
+                                               row.getDimensions());
+    }
+    MtmVec <T> newRow = row;
+    if (newRow.getDimensions().getRow() != 1) {
+        newRow.transpose();
+    }
+    newRow.allowAllVec();
+
+    MTM_STATS_ALLOCATE(sizeof(MtmVec < T > ));
+    MtmVec<MtmVec<T>>::Storage::push_back(std::move(newRow));
+    this->objectDimensions = Dimensions(this->size(), cols);
+}
+catch (std::bad_alloc &e) {
+    throw MtmMath::MtmExceptions::OutOfMemory();
+}
+
+template<typename T>
+void MtmMat<T>::appendCol(const MtmVec <T> &col) try {
+    size_t rows = (size_t) this->objectDimensions.getRow();
+    size_t cols = (size_t) this->objectDimensions.getCol();
+    if (col.size() != rows) {
+        throw MtmExceptions::DimensionMismatch(Dimensions(rows, 1),
+                                               col.getDimensions());
+    }
+    //col may be one of the rows, which the appends below reallocate
+    const MtmVec <T> *first = this->data();
+    std::less<const MtmVec <T> *> before;
+    typename MtmVec<T>::Storage copy;
+    const T *in = col.data();
+    if (!before(&col, first) && before(&col, first + rows)) {
+        copy = col;
+        in = copy.data();
+    }
+    for (size_t i = 0; i < rows; i++) {
+        MtmVec <T> &row = this->data()[i];
+        row.append(in[i]);
+        //a one element row reads as a column, append grew it downwards
+        if (cols == 1) {
+            row.transpose();
+        }
+    }
+    this->objectDimensions = Dimensions(rows, cols + 1);
+}
+catch (std::bad_alloc &e) {
+    throw MtmMath::MtmExceptions::OutOfMemory();
+}
+
+template<typename T>
+void MtmMat<T>::reserve(Dimensions capacity) try {
+    MtmVec<MtmVec<T>>::Storage::reserve((size_t) capacity.getRow());
+    for (size_t i = 0; i < this->size(); i++) {
+        this->data()[i].MtmVec<T>::Storage::reserve(
+                (size_t) capacity.getCol());
+    }
+}
+catch (std::bad_alloc &e) {
+    throw MtmMath::MtmExceptions::OutOfMemory();
+}
+
+template<typename T>
+void MtmMat<T>::shrink_to_fit() {
+    MtmVec<MtmVec<T>>::Storage::shrink_to_fit();
+    this->permissions.shrink_to_fit();
+    for (size_t i = 0; i < this->size(); i++) {
+        this->data()[i].MtmVec<T>::Storage::shrink_to_fit();
+        this->data()[i].permissions.shrink_to_fit();
+    }
+}
+
 template<typename T>
 void MtmMat<T>::reshape(Dimensions newDim) {
     if (newDim.getRow() * newDim.getCol() !=
         this->objectDimensions.getCol() * this->objectDimensions.getRow()) {
         throw MtmExceptions::ChangeMatFail(this->getDimensions(), newDim);
     }
+    MTM_STATS_OPERATION(MAT_RESHAPE, 0);
 
     MtmMat <T> newShape = MtmMat<T>(newDim);
 
-    for (int i = 0; i < newDim.getRow() * newDim.getCol(); i++) {
-        int oldRow = i % this->objectDimensions.getRow();
-        int newRow = i % newDim.getRow();
-        int oldCol = i / this->objectDimensions.getRow();
-        int newCol = i / newDim.getRow();
+    for (index_t i = 0; i < newDim.getRow() * newDim.getCol(); i++) {
+        index_t oldRow = i % this->objectDimensions.getRow();
+        index_t newRow = i % newDim.getRow();
+        index_t oldCol = i / this->objectDimensions.getRow();
+        index_t newCol = i / newDim.getRow();
         try {
             newShape[newRow][newCol] = (*this)[oldRow][oldCol];
         }
@@ -556,13 +1024,14 @@ void MtmMat<T>::reshape(Dimensions newDim) {
 
 template<typename T>
 void MtmMat<T>::transpose() {
+    MTM_STATS_OPERATION(MAT_TRANSPOSE, 0);
     allowAllVec();
     Dimensions newDim = Dimensions(MtmMat<T>::getDimensions());
     newDim.transpose();
     MtmMat <T> newShape = MtmMat<T>(newDim, T());
 
-    for (int i = 0; i < MtmMat<T>::getDimensions().getRow(); i++) {
-        for (int j = 0; j < MtmMat<T>::getDimensions().getCol(); j++) {
+    for (index_t i = 0; i < MtmMat<T>::getDimensions().getRow(); i++) {
+        for (index_t j = 0; j < MtmMat<T>::getDimensions().getCol(); j++) {
             newShape[j][i] = (*this)[i][j];
         }
     }
@@ -0,0 +1,306 @@
+#ifndef EX3_MTMMATBAND_H
+#define EX3_MTMMATBAND_H
+
+#include <algorithm>
+#include <vector>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+namespace MtmMath {
+
+    /*
+     * Square band matrix - only the diagonals from -lower to +upper are
+     * stored, so memory is n * (lower + upper + 1) instead of n^2.
+     * Row i keeps columns i - lower .. i + upper in one contiguous slot.
+     */
+    template<typename T>
+    class MtmMatBand {
+        size_t n;
+        size_t lower;
+        size_t upper;
+        std::vector<T> bands;
+
+        size_t width() const {
+            return lower + upper + 1;
+        }
+
+        bool inBand(size_t i, size_t j) const {
+            return (j + lower >= i) && (j <= i + upper);
+        }
+
+        size_t location(size_t i, size_t j) const {
+            return i * width() + (j + lower - i);
+        }
+
+        void factorizeLU();
+
+        void solveTridiagonal(T *x) const;
+
+        void solveLU(T *x) const;
+
+    public:
+
+        /*
+         * Band matrix constructor, m is the number of rows and columns,
+         * lower_t/upper_t are the number of sub/super diagonals and val is
+         * the initial value of every element inside the band. Bandwidths
+         * past the matrix are clamped to m - 1 (a 1x1 tridiagonal matrix
+         * is just its diagonal).
+         */
+        MtmMatBand(size_t m, size_t lower_t, size_t upper_t,
+                   const T &val = T()) try : n(m), lower(lower_t),
+                                             upper(upper_t) {
+            if (m == 0) {
+                throw MtmExceptions::IllegalInitialization();
+            }
+            lower = std::min(lower, m - 1);
+            upper = std::min(upper, m - 1);
+            bands.assign(n * width(), val);
+
+            //slots that fall outside the matrix stay zero
+            for (size_t i = 0; i < n; i++) {
+                for (size_t d = 0; d < width(); d++) {
+                    if (i + d < lower || i + d - lower >= n) {
+                        bands[i * width() + d] = T();
+                    }
+                }
+            }
+        }
+        catch (std::bad_alloc &e) {
+            throw MtmExceptions::OutOfMemory();
+        }
+
+        /*
+         * Builds a band matrix out of a square matrix, every element outside
+         * the requested band has to be zero
+         */
+        MtmMatBand(const MtmMat<T> &toConvert, size_t lower_t,
+                   size_t upper_t) : MtmMatBand(
+                (size_t) toConvert.getDimensions().getRow(), lower_t,
+                upper_t) {
+            if (toConvert.getDimensions().getRow() !=
+                toConvert.getDimensions().getCol()) {
+                throw MtmExceptions::IllegalInitialization();
+            }
+            for (size_t i = 0; i < n; i++) {
+                const T *row = toConvert[(index_t) i].data();
+                for (size_t j = 0; j < n; j++) {
+                    if (inBand(i, j)) {
+                        bands[location(i, j)] = row[j];
+                    } else if (row[j] != T()) {
+                        throw MtmExceptions::IllegalInitialization();
+                    }
+                }
+            }
+        }
+
+        MtmMatBand(const MtmMatBand<T> &toCopy) = default;
+
+        ~MtmMatBand() = default;
+
+        MtmMatBand &operator=(const MtmMatBand<T> &c) = default;
+
+        /*
+         * Element access, elements outside the band can be read (as zero)
+         * but not written
+         */
+        T &operator()(size_t i, size_t j) {
+            if (i >= n || j >= n || !inBand(i, j)) {
+                throw MtmExceptions::AccessIllegalElement();
+            }
+            return bands[location(i, j)];
+        }
+
+        T operator()(size_t i, size_t j) const {
+            if (i >= n || j >= n) {
+                throw MtmExceptions::AccessIllegalElement();
+            }
+            if (!inBand(i, j)) {
+                return T();
+            }
+            return bands[location(i, j)];
+        }
+
+        Dimensions getDimensions() const {
+            return Dimensions(n, n);
+        }
+
+        size_t getLower() const {
+            return lower;
+        }
+
+        size_t getUpper() const {
+            return upper;
+        }
+
+        bool isTridiagonal() const {
+            return lower == 1 && upper == 1;
+        }
+
+        /*
+         * Expands the band matrix back into a dense MtmMat
+         */
+        MtmMat<T> toMat() const;
+
+        /*
+         * Solves this * x = b for a column vector b. Tridiagonal matrices use
+         * the Thomas algorithm, other bandwidths an LU factorization inside
+         * the band. No pivoting is done, so the matrix has to be diagonally
+         * dominant or otherwise safe to eliminate without row swaps.
+         * Runs in O(n * lower * upper).
+         */
+        MtmVec<T> solve(const MtmVec<T> &b) const;
+
+        /*
+         * y = this * x on raw arrays of n elements
+         */
+        void multiply(const T *x, T *y) const;
+
+        template<typename S>
+        friend MtmVec<S> operator*(const MtmMatBand<S> &a,
+                                   const MtmVec<S> &x);
+    };
+
+    template<typename T>
+    MtmMat<T> MtmMatBand<T>::toMat() const {
+        MtmMat<T> result = MtmMat<T>(Dimensions(n, n), T());
+        for (size_t i = 0; i < n; i++) {
+            T *row = result[(index_t) i].data();
+            size_t first = i > lower ? i - lower : 0;
+            size_t last = std::min(n - 1, i + upper);
+            for (size_t j = first; j <= last; j++) {
+                row[j] = bands[location(i, j)];
+            }
+        }
+        return result;
+    }
+
+    template<typename T>
+    void MtmMatBand<T>::multiply(const T *x, T *y) const {
+        MTM_STATS_OPERATION(BAND_MULTIPLY, 2 * n * width());
+
+        for (size_t i = 0; i < n; i++) {
+            size_t first = i > lower ? i - lower : 0;
+            size_t last = std::min(n - 1, i + upper);
+            const T *row = bands.data() + location(i, first);
+            T sum = T();
+            for (size_t j = first; j <= last; j++) {
+                sum += row[j - first] * x[j];
+            }
+            y[i] = sum;
+        }
+    }
+
+    /*
+     * Band matrix times column vector, only touches the stored diagonals
+     */
+    template<typename T>
+    MtmVec<T> operator*(const MtmMatBand<T> &a, const MtmVec<T> &x) {
+        if (x.getDimensions() != Dimensions(a.n, 1)) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   x.getDimensions());
+        }
+        MtmVec<T> result = MtmVec<T>(a.n, T());
+        a.multiply(x.data(), result.data());
+        return result;
+    }
+
+    template<typename T>
+    void MtmMatBand<T>::factorizeLU() {
+        for (size_t k = 0; k < n; k++) {
+            T pivot = bands[location(k, k)];
+            if (pivot == T()) {
+                throw MtmExceptions::SingularMatrix();
+            }
+            size_t lastRow = std::min(n - 1, k + lower);
+            size_t lastCol = std::min(n - 1, k + upper);
+            for (size_t i = k + 1; i <= lastRow; i++) {
+                T factor = bands[location(i, k)];
+                if (factor == T()) {
+                    continue;
+                }
+                T quotient = factor / pivot;
+                bands[location(i, k)] = quotient;
+                for (size_t j = k + 1; j <= lastCol; j++) {
+                    bands[location(i, j)] -= quotient * bands[location(k, j)];
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    void MtmMatBand<T>::solveLU(T *x) const {
+        //forward substitution with the unit lower factor
+        for (size_t i = 1; i < n; i++) {
+            size_t first = i > lower ? i - lower : 0;
+            for (size_t j = first; j < i; j++) {
+                x[i] -= bands[location(i, j)] * x[j];
+            }
+        }
+        //back substitution with the upper factor
+        for (size_t i = n; i-- > 0;) {
+            size_t last = std::min(n - 1, i + upper);
+            for (size_t j = i + 1; j <= last; j++) {
+                x[i] -= bands[location(i, j)] * x[j];
+            }
+            x[i] = x[i] / bands[location(i, i)];
+        }
+    }
+
+    template<typename T>
+    void MtmMatBand<T>::solveTridiagonal(T *x) const {
+        std::vector<T> superPrime(n, T());
+
+        T diagonal = bands[location(0, 0)];
+        if (diagonal == T()) {
+            throw MtmExceptions::SingularMatrix();
+        }
+        if (n > 1) {
+            superPrime[0] = bands[location(0, 1)] / diagonal;
+        }
+        x[0] = x[0] / diagonal;
+
+        for (size_t i = 1; i < n; i++) {
+            T sub = bands[location(i, i - 1)];
+            T denominator = bands[location(i, i)] - sub * superPrime[i - 1];
+            if (denominator == T()) {
+                throw MtmExceptions::SingularMatrix();
+            }
+            if (i + 1 < n) {
+                superPrime[i] = bands[location(i, i + 1)] / denominator;
+            }
+            x[i] = (x[i] - sub * x[i - 1]) / denominator;
+        }
+
+        for (size_t i = n - 1; i-- > 0;) {
+            x[i] -= superPrime[i] * x[i + 1];
+        }
+    }
+
+    template<typename T>
+    MtmVec<T> MtmMatBand<T>::solve(const MtmVec<T> &b) const {
+        if (b.getDimensions() != Dimensions(n, 1)) {
+            throw MtmExceptions::DimensionMismatch(getDimensions(),
+                                                   b.getDimensions());
+        }
+        MTM_STATS_OPERATION(BAND_SOLVE, 2 * n * (lower * upper + width()));
+
+        MtmVec<T> result = b;
+        result.allowAllVec();
+        if (isTridiagonal()) {
+            solveTridiagonal(result.data());
+            return result;
+        }
+
+        MtmMatBand<T> factors = *this;
+        factors.factorizeLU();
+        factors.solveLU(result.data());
+        return result;
+    }
+
+}
+
+#endif //EX3_MTMMATBAND_H
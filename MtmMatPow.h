@@ -0,0 +1,154 @@
+#ifndef EX3_MTMMATPOW_H
+#define EX3_MTMMATPOW_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmMat.h"
+#include "MtmMatSq.h"
+
+using std::size_t;
+
+/*
+ * Powers and polynomials of square matrices without a new allocation per
+ * product. Every product goes through multiplyInto, so element types
+ * with their own kernel (ModInt) get it here as well.
+ */
+
+namespace MtmMath {
+
+    namespace MtmMatPowOps {
+
+        template<typename T>
+        void setIdentity(MtmMat<T> &a, const T &scale) {
+            size_t n = (size_t) a.getDimensions().getRow();
+            for (size_t i = 0; i < n; i++) {
+                T *row = a[(index_t) i].data();
+                std::fill(row, row + n, T());
+                row[i] = scale;
+            }
+        }
+
+        /*
+         * O(1) exchange of the row storage of two matrices of the same
+         * dimensions
+         */
+        template<typename T>
+        void swapRows(MtmMat<T> &a, MtmMat<T> &b) {
+            static_cast<typename MtmVec<MtmVec<T>>::Storage &>(a).swap(b);
+        }
+
+        /*
+         * out += sum of coefficients[first + i] * a^i for i < count, with
+         * powers[i] = a^i (powers[0] stands for the identity, not read)
+         */
+        template<typename T>
+        void addBlock(const std::vector<MtmMatSq<T>> &powers,
+                      const std::vector<T> &coefficients, size_t first,
+                      size_t count, MtmMat<T> &out) {
+            size_t n = (size_t) out.getDimensions().getRow();
+            for (size_t r = 0; r < n; r++) {
+                out[(index_t) r].data()[r] += coefficients[first];
+            }
+            for (size_t i = 1; i < count; i++) {
+                const T c = coefficients[first + i];
+                if (c == T()) {
+                    continue;
+                }
+                for (size_t r = 0; r < n; r++) {
+                    const T *in = powers[i][(index_t) r].data();
+                    T *row = out[(index_t) r].data();
+                    for (size_t j = 0; j < n; j++) {
+                        row[j] += c * in[j];
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * a^k by repeated squaring: floor(log2 k) squarings and one product
+     * per further set bit of k. Only two buffers besides the result are
+     * used, the products ping-pong between them.
+     */
+    template<typename T>
+    MtmMatSq<T> pow(const MtmMatSq<T> &a, unsigned long long k) {
+        size_t n = (size_t) a.getDimensions().getRow();
+        MtmMatSq<T> result = MtmMatSq<T>(n);
+        if (k == 0) {
+            MtmMatPowOps::setIdentity(result, T(1));
+            return result;
+        }
+        MtmMatSq<T> base = a;
+        MtmMatSq<T> spare = MtmMatSq<T>(n);
+        while ((k & 1) == 0) {
+            multiplyInto(base, base, spare);
+            MtmMatPowOps::swapRows(base, spare);
+            k >>= 1;
+        }
+        result = base;
+        for (k >>= 1; k != 0; k >>= 1) {
+            multiplyInto(base, base, spare);
+            MtmMatPowOps::swapRows(base, spare);
+            if (k & 1) {
+                multiplyInto(result, base, spare);
+                MtmMatPowOps::swapRows(result, spare);
+            }
+        }
+        return result;
+    }
+
+    /*
+     * sum of coefficients[i] * a^i (coefficients[0] times the identity)
+     * by Paterson-Stockmeyer: with s about sqrt(degree), a^2..a^s are
+     * formed once and the polynomial is run as Horner's rule in a^s over
+     * blocks of s coefficients. That is about 2 * sqrt(degree) matrix
+     * products instead of degree, at the cost of s stored powers.
+     */
+    template<typename T>
+    MtmMatSq<T> polynomial(const MtmMatSq<T> &a,
+                           const std::vector<T> &coefficients) {
+        size_t n = (size_t) a.getDimensions().getRow();
+        MtmMatSq<T> result = MtmMatSq<T>(n);
+        if (coefficients.empty()) {
+            return result;
+        }
+        size_t degree = coefficients.size() - 1;
+        size_t s = (size_t) std::ceil(std::sqrt((double) degree + 1));
+
+        size_t blocks = degree / s;
+
+        //powers[i] = a^i up to a^s (only up to the degree when there is a
+        //single block), powers[0] is unused
+        size_t highest = blocks > 0 ? s : degree;
+        std::vector<MtmMatSq<T>> powers;
+        powers.reserve(highest + 1);
+        powers.push_back(MtmMatSq<T>(1));
+        if (highest > 0) {
+            powers.push_back(a);
+        }
+        for (size_t i = 2; i <= highest; i++) {
+            powers.push_back(MtmMatSq<T>(n));
+            multiplyInto(powers[i - 1], a, powers[i]);
+        }
+
+        //Horner over blocks of s coefficients: result = result * a^s + block
+        MtmMatPowOps::addBlock(powers, coefficients, blocks * s,
+                               coefficients.size() - blocks * s, result);
+        if (blocks > 0) {
+            MtmMatSq<T> spare = MtmMatSq<T>(n);
+            for (size_t j = blocks; j-- > 0;) {
+                multiplyInto(result, powers[s], spare);
+                MtmMatPowOps::swapRows(result, spare);
+                MtmMatPowOps::addBlock(powers, coefficients, j * s, s,
+                                       result);
+            }
+        }
+        return result;
+    }
+
+}
+
+#endif //EX3_MTMMATPOW_H
@@ -0,0 +1,228 @@
+#ifndef EX3_MTMMATSPARSE_H
+#define EX3_MTMMATSPARSE_H
+
+#include <vector>
+#include <algorithm>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmKernels.h"
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+namespace MtmMath {
+
+    /*
+     * Sparse matrix in compressed sparse row (CSR) form - row i keeps its
+     * non zero columns (sorted) and values in
+     * [rowStart[i], rowStart[i + 1]) of columns/values, so memory is
+     * O(rows + non zeros).
+     */
+    template<typename T>
+    class MtmMatSparse {
+        size_t rows;
+        size_t cols;
+        std::vector<size_t> rowStart;
+        std::vector<size_t> columns;
+        std::vector<T> values;
+
+    public:
+
+        /*
+         * One (row, col, value) element, used to build the matrix
+         */
+        struct Entry {
+            size_t row;
+            size_t col;
+            T value;
+        };
+
+        /*
+         * Empty (all zero) sparse matrix of the given dimensions
+         */
+        explicit MtmMatSparse(const Dimensions &dim_t) try
+                : rows((size_t) dim_t.getRow()),
+                  cols((size_t) dim_t.getCol()),
+                  rowStart((size_t) dim_t.getRow() + 1, 0) {
+            if (rows == 0 || cols == 0) {
+                throw MtmExceptions::IllegalInitialization();
+            }
+        }
+        catch (std::bad_alloc &e) {
+            throw MtmExceptions::OutOfMemory();
+        }
+
+        /*
+         * Builds the matrix out of entries given in any order, entries
+         * with the same position are added together
+         */
+        MtmMatSparse(const Dimensions &dim_t,
+                     const std::vector<Entry> &entries);
+
+        /*
+         * Keeps the non zero elements of a dense matrix
+         */
+        explicit MtmMatSparse(const MtmMat<T> &toConvert);
+
+        MtmMatSparse(const MtmMatSparse<T> &toCopy) = default;
+
+        ~MtmMatSparse() = default;
+
+        MtmMatSparse &operator=(const MtmMatSparse<T> &c) = default;
+
+        /*
+         * Element read, zeros that are not stored come back as T()
+         */
+        T operator()(size_t i, size_t j) const {
+            if (i >= rows || j >= cols) {
+                throw MtmExceptions::AccessIllegalElement();
+            }
+            const size_t *first = columns.data() + rowStart[i];
+            const size_t *last = columns.data() + rowStart[i + 1];
+            const size_t *found = std::lower_bound(first, last, j);
+            if (found == last || *found != j) {
+                return T();
+            }
+            return values[found - columns.data()];
+        }
+
+        Dimensions getDimensions() const {
+            return Dimensions(rows, cols);
+        }
+
+        size_t getNonZeroCount() const {
+            return values.size();
+        }
+
+        /*
+         * Expands the sparse matrix into a dense MtmMat
+         */
+        MtmMat<T> toMat() const;
+
+        /*
+         * y = this * x on raw arrays of cols and rows elements, rows are
+         * split between threads once there is enough work
+         */
+        void multiply(const T *x, T *y) const;
+
+        template<typename S>
+        friend MtmVec<S> operator*(const MtmMatSparse<S> &a,
+                                   const MtmVec<S> &x);
+
+        template<typename S>
+        friend class IncompleteLU;
+    };
+
+    template<typename T>
+    MtmMatSparse<T>::MtmMatSparse(const Dimensions &dim_t,
+                                  const std::vector<Entry> &entries)
+            : MtmMatSparse(dim_t) {
+        for (size_t e = 0; e < entries.size(); e++) {
+            if (entries[e].row >= rows || entries[e].col >= cols) {
+                throw MtmExceptions::AccessIllegalElement();
+            }
+            rowStart[entries[e].row + 1]++;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            rowStart[i + 1] += rowStart[i];
+        }
+
+        //counting sort by row, then sort and merge every row by column
+        std::vector<size_t> order(entries.size());
+        std::vector<size_t> next(rowStart.begin(), rowStart.end() - 1);
+        for (size_t e = 0; e < entries.size(); e++) {
+            order[next[entries[e].row]++] = e;
+        }
+        columns.reserve(entries.size());
+        values.reserve(entries.size());
+        size_t begin = 0;
+        for (size_t i = 0; i < rows; i++) {
+            size_t end = rowStart[i + 1];
+            std::sort(order.begin() + begin, order.begin() + end,
+                      [&entries](size_t a, size_t b) {
+                          return entries[a].col < entries[b].col;
+                      });
+            rowStart[i] = columns.size();
+            for (size_t e = begin; e < end; e++) {
+                const Entry &entry = entries[order[e]];
+                if (columns.size() > rowStart[i] &&
+                    columns.back() == entry.col) {
+                    values.back() += entry.value;
+                    continue;
+                }
+                columns.push_back(entry.col);
+                values.push_back(entry.value);
+            }
+            begin = end;
+        }
+        rowStart[rows] = columns.size();
+    }
+
+    template<typename T>
+    MtmMatSparse<T>::MtmMatSparse(const MtmMat<T> &toConvert)
+            : MtmMatSparse(toConvert.getDimensions()) {
+        for (size_t i = 0; i < rows; i++) {
+            const T *row = toConvert[(index_t) i].data();
+            for (size_t j = 0; j < cols; j++) {
+                if (row[j] != T()) {
+                    columns.push_back(j);
+                    values.push_back(row[j]);
+                }
+            }
+            rowStart[i + 1] = columns.size();
+        }
+    }
+
+    template<typename T>
+    MtmMat<T> MtmMatSparse<T>::toMat() const {
+        MtmMat<T> result = MtmMat<T>(Dimensions(rows, cols), T());
+        for (size_t i = 0; i < rows; i++) {
+            T *row = result[(index_t) i].data();
+            for (size_t e = rowStart[i]; e < rowStart[i + 1]; e++) {
+                row[columns[e]] = values[e];
+            }
+        }
+        return result;
+    }
+
+    template<typename T>
+    void MtmMatSparse<T>::multiply(const T *x, T *y) const {
+        MTM_STATS_OPERATION(SPARSE_MULTIPLY, 2 * values.size());
+
+        auto rowsBody = [this, x, y](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                T sum = T();
+                for (size_t e = rowStart[i]; e < rowStart[i + 1]; e++) {
+                    sum += values[e] * x[columns[e]];
+                }
+                y[i] = sum;
+            }
+        };
+        if (values.size() < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+            rowsBody(0, rows);
+            return;
+        }
+        size_t perRow = values.size() / rows + 1;
+        MtmScheduler::parallelFor(
+                0, rows, MtmKernels::GEMV_PARALLEL_THRESHOLD / 4 / perRow + 1,
+                rowsBody);
+    }
+
+    /*
+     * Sparse matrix times column vector, O(rows + non zeros)
+     */
+    template<typename T>
+    MtmVec<T> operator*(const MtmMatSparse<T> &a, const MtmVec<T> &x) {
+        if (x.getDimensions() != Dimensions(a.cols, 1)) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   x.getDimensions());
+        }
+        MtmVec<T> result = MtmVec<T>(a.rows, T());
+        a.multiply(x.data(), result.data());
+        return result;
+    }
+
+}
+
+#endif //EX3_MTMMATSPARSE_H
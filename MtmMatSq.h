@@ -30,6 +30,21 @@ namespace MtmMath {
 
         void resize(Dimensions dim, const T &val);
 
+        //appending a single row or column would make the matrix non square
+        void appendRow(const MtmVec <T> &) override {
+            throw MtmExceptions::ChangeMatFail(
+                    this->getDimensions(),
+                    Dimensions(this->getDimensions().getRow() + 1,
+                               this->getDimensions().getCol()));
+        }
+
+        void appendCol(const MtmVec <T> &) override {
+            throw MtmExceptions::ChangeMatFail(
+                    this->getDimensions(),
+                    Dimensions(this->getDimensions().getRow(),
+                               this->getDimensions().getCol() + 1));
+        }
+
 
         MtmMatSq() = default;
 
@@ -24,11 +24,11 @@ namespace MtmMath {
          */
         MtmMatTriag<T>(size_t m, const T &val = T(), bool isUpper_t = true)
                 : MtmMatSq<T>(m, val), isUpper(isUpper_t) {
-            for (int i = 0; i < (int) m; i++) {
-                for (int j = 0; j < (int) m; j++) {
+            for (index_t i = 0; i < (index_t) m; i++) {
+                for (index_t j = 0; j < (index_t) m; j++) {
                     if ((isUpper && j < i) || (!isUpper && j > i)) {
                         (*this)[i][j] = 0;
-                        ((*this)[i]).permissions[j] = false;
+                        ((*this)[i]).forbid((size_t) j);
                     }
                 }
             }
@@ -39,16 +39,16 @@ namespace MtmMath {
         MtmMatTriag(const MtmMatSq <T> &toCopy) : MtmMatSq<T>(toCopy) {
             bool isTriag = true;
             isUpper = true;
-            for (int i = 0; i < toCopy.getDimensions().getRow(); i++) {
-                for (int j = 0; j < i; j++) {
+            for (index_t i = 0; i < toCopy.getDimensions().getRow(); i++) {
+                for (index_t j = 0; j < i; j++) {
                     if (toCopy[i][j] != 0) {
                         isUpper = false;
                     }
                 }
             }
             if (!isUpper) {
-                for (int i = 0; i < toCopy.getDimensions().getRow(); i++) {
-                    for (int j = i + 1;
+                for (index_t i = 0; i < toCopy.getDimensions().getRow(); i++) {
+                    for (index_t j = i + 1;
                          j < toCopy.getDimensions().getCol(); j++) {
                         if (toCopy[i][j] != 0) {
                             isTriag = false;
@@ -59,10 +59,10 @@ namespace MtmMath {
             if (!isTriag) {
                 throw MtmExceptions::IllegalInitialization();
             }
-            for (int i = 0; i < toCopy.getDimensions().getRow(); i++) {
-                for (int j = 0; j < toCopy.getDimensions().getRow(); j++) {
+            for (index_t i = 0; i < toCopy.getDimensions().getRow(); i++) {
+                for (index_t j = 0; j < toCopy.getDimensions().getRow(); j++) {
                     if ((isUpper && j < i) || (!isUpper && j > i)) {
-                        ((*this)[i]).permissions[j] = false;
+                        ((*this)[i]).forbid((size_t) j);
                     }
                 }
             }
@@ -84,13 +84,17 @@ namespace MtmMath {
 
         void resize(Dimensions dim, const T &val);
 
+        bool isUpperTriangular() const {
+            return isUpper;
+        }
+
         void transpose() {
             MtmMatTriag<T> result = MtmMatTriag(*this);
             result.isUpper = !(isUpper);
             result.allowAllVec();
 
-            for (int i = 0; i < result.getDimensions().getRow(); i++) {
-                for (int j = 0; j < result.getDimensions().getCol(); j++) {
+            for (index_t i = 0; i < result.getDimensions().getRow(); i++) {
+                for (index_t j = 0; j < result.getDimensions().getCol(); j++) {
                     try {
                         result[i][j] = (*this)[j][i];
                     }
@@ -99,7 +103,7 @@ namespace MtmMath {
                     }
                     if ((result.isUpper && j < i) ||
                         (!result.isUpper && j > i)) {
-                        ((result)[i]).permissions[j] = false;
+                        ((result)[i]).forbid((size_t) j);
                     }
                 }
             }
@@ -113,17 +117,110 @@ namespace MtmMath {
 
         MtmMatSq<T>::resize(dim, val);
 
-        for (int i = 0; i < (*this).getDimensions().getRow(); i++) {
-            for (int j = 0; j < (*this).getDimensions().getCol(); j++) {
+        for (index_t i = 0; i < (*this).getDimensions().getRow(); i++) {
+            for (index_t j = 0; j < (*this).getDimensions().getCol(); j++) {
                 if ((isUpper && j < i) || (!isUpper && j > i)) {
                     (*this)[i][j] = 0;
-                    ((*this)[i]).permissions[j] = false;
+                    ((*this)[i]).forbid((size_t) j);
                 }
             }
         }
 
     }
 
+    //TRIANGULAR PRODUCTS
+
+    template<typename T>
+    MtmKernels::Shape shapeOf(const MtmMatTriag<T> &a) {
+        return a.isUpperTriangular() ? MtmKernels::UPPER : MtmKernels::LOWER;
+    }
+
+    /*
+     * result += a * b where a and b have the given shapes, result has to be
+     * allocated with the dimensions of the product
+     */
+    template<typename T>
+    void multiplyShaped(const MtmMat<T> &a, MtmKernels::Shape aShape,
+                        const MtmMat<T> &b, MtmKernels::Shape bShape,
+                        MtmMat<T> &result) {
+        if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   b.getDimensions());
+        }
+        size_t m = (size_t) a.getDimensions().getRow();
+        size_t n = (size_t) b.getDimensions().getCol();
+        size_t k = (size_t) a.getDimensions().getCol();
+        MTM_STATS_OPERATION(TRIANGULAR_MULTIPLY,
+                            2 * MtmKernels::gemmTriangularCount(
+                                    m, n, k, aShape, bShape));
+
+        MtmKernels::gemmTriangular<T>(
+                m, n, k, aShape, bShape,
+                MtmKernels::MatRows<const MtmMat<T>, const T>(a),
+                MtmKernels::MatRows<const MtmMat<T>, const T>(b),
+                MtmKernels::MatRows<MtmMat<T>, T>(result));
+    }
+
+    /*
+     * Product of two triangular matrices of the same orientation, which is
+     * triangular again. Does about a sixth of the work of a dense product.
+     */
+    template<typename T>
+    MtmMatTriag<T> multiplyTriangular(const MtmMatTriag<T> &a,
+                                      const MtmMatTriag<T> &b) {
+        if (a.isUpperTriangular() != b.isUpperTriangular()) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        if (a.getDimensions() != b.getDimensions()) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   b.getDimensions());
+        }
+        MtmMatTriag<T> result = MtmMatTriag<T>(
+                (size_t) a.getDimensions().getRow(), T(),
+                a.isUpperTriangular());
+        multiplyShaped(a, shapeOf(a), b, shapeOf(b), result);
+        return result;
+    }
+
+    /*
+     * Triangular times triangular in any orientation. An upper times a
+     * lower matrix is full, so the result is a plain MtmMat - use
+     * multiplyTriangular to keep the structure when both have the same
+     * orientation. Only the non zero halves are multiplied.
+     */
+    template<typename T>
+    MtmMat<T> operator*(const MtmMatTriag<T> &a, const MtmMatTriag<T> &b) {
+        MtmMat<T> result = MtmMat<T>(Dimensions(
+                (size_t) a.getDimensions().getRow(),
+                (size_t) b.getDimensions().getCol()), T());
+        multiplyShaped(a, shapeOf(a), b, shapeOf(b), result);
+        return result;
+    }
+
+    /*
+     * Triangular times dense, skips the zero half of a
+     */
+    template<typename T>
+    MtmMat<T> operator*(const MtmMatTriag<T> &a, const MtmMat<T> &b) {
+        MtmMat<T> result = MtmMat<T>(Dimensions(
+                (size_t) a.getDimensions().getRow(),
+                (size_t) b.getDimensions().getCol()), T());
+        multiplyShaped(a, shapeOf(a), b, MtmKernels::DENSE, result);
+        return result;
+    }
+
+    /*
+     * Dense times triangular, skips the zero half of b
+     */
+    template<typename T>
+    MtmMat<T> operator*(const MtmMat<T> &a, const MtmMatTriag<T> &b) {
+        MtmMat<T> result = MtmMat<T>(Dimensions(
+                (size_t) a.getDimensions().getRow(),
+                (size_t) b.getDimensions().getCol()), T());
+        multiplyShaped(a, MtmKernels::DENSE, b, shapeOf(b), result);
+        return result;
+    }
+
 }
 
 #endif //EX3_MTMMATTRIAG_H
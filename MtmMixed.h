@@ -0,0 +1,461 @@
+#ifndef EX3_MTMMIXED_H
+#define EX3_MTMMIXED_H
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "Complex.h"
+#include "MtmCpu.h"
+#include "MtmKernels.h"
+#include "MtmScheduler.h"
+#include "MtmStats.h"
+#include "MtmMap.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+/*
+ * Arithmetic between vectors, matrices and scalars of different element
+ * types (int / float / double / Complex) without converting an operand
+ * first. The result has the promoted type of the element product
+ * (int * double -> double, double * Complex -> Complex, ...), every
+ * element is widened only where it is used, and a real times a Complex
+ * costs two multiplies instead of a full complex product.
+ * These overloads only take part when the element types differ, same
+ * type arithmetic keeps using the operators of MtmVec / MtmMat.
+ */
+
+namespace MtmMath {
+
+    namespace MtmMixedOps {
+
+        template<typename S>
+        struct IsScalar : std::integral_constant<bool,
+                std::is_arithmetic<S>::value ||
+                std::is_same<S, Complex>::value> {
+        };
+
+        template<typename A, typename B>
+        using Promoted = typename std::decay<decltype(
+                std::declval<const A &>() * std::declval<const B &>())>::type;
+
+        //enables an overload for two different scalar element types
+        template<typename A, typename B>
+        using Mixed = typename std::enable_if<
+                !std::is_same<A, B>::value && IsScalar<A>::value &&
+                IsScalar<B>::value>::type;
+
+        template<typename A, typename B>
+        Promoted<A, B> product(const A &a, const B &b) {
+            typedef Promoted<A, B> R;
+            return R(a) * R(b);
+        }
+
+        template<typename S, typename = typename std::enable_if<
+                std::is_arithmetic<S>::value>::type>
+        Complex product(const S &a, const Complex &b) {
+            return Complex(a * b.getReal(), a * b.getImag());
+        }
+
+        template<typename S, typename = typename std::enable_if<
+                std::is_arithmetic<S>::value>::type>
+        Complex product(const Complex &a, const S &b) {
+            return Complex(a.getReal() * b, a.getImag() * b);
+        }
+
+        template<typename A, typename B>
+        Promoted<A, B> sum(const A &a, const B &b) {
+            typedef Promoted<A, B> R;
+            return R(a) + R(b);
+        }
+
+        template<typename S, typename = typename std::enable_if<
+                std::is_arithmetic<S>::value>::type>
+        Complex sum(const S &a, const Complex &b) {
+            return Complex(a + b.getReal(), b.getImag());
+        }
+
+        template<typename S, typename = typename std::enable_if<
+                std::is_arithmetic<S>::value>::type>
+        Complex sum(const Complex &a, const S &b) {
+            return Complex(a.getReal() + b, a.getImag());
+        }
+
+        template<typename A, typename B>
+        Promoted<A, B> difference(const A &a, const B &b) {
+            typedef Promoted<A, B> R;
+            return R(a) - R(b);
+        }
+
+        template<typename S, typename = typename std::enable_if<
+                std::is_arithmetic<S>::value>::type>
+        Complex difference(const S &a, const Complex &b) {
+            return Complex(a - b.getReal(), -b.getImag());
+        }
+
+        template<typename S, typename = typename std::enable_if<
+                std::is_arithmetic<S>::value>::type>
+        Complex difference(const Complex &a, const S &b) {
+            return Complex(a.getReal() - b, a.getImag());
+        }
+
+        /*
+         * C += A * B like MtmKernels::gemmBlocked where A, B and C have
+         * element types A, B and R. The element of A stays in its own
+         * type across the inner loop.
+         */
+        template<typename R, typename ARows, typename BRows, typename CRows>
+        void gemm(size_t m, size_t n, size_t k, ARows aRow, BRows bRow,
+                  CRows cRow) {
+            using MtmKernels::GEMM_BLOCK_ROWS;
+            using MtmKernels::GEMM_BLOCK_DEPTH;
+            using MtmKernels::GEMM_BLOCK_COLS;
+            MtmCpu::dispatchFor<R>([&] {
+                for (size_t ii = 0; ii < m; ii += GEMM_BLOCK_ROWS) {
+                    size_t iEnd = std::min(m, ii + GEMM_BLOCK_ROWS);
+                    for (size_t pp = 0; pp < k; pp += GEMM_BLOCK_DEPTH) {
+                        size_t pEnd = std::min(k, pp + GEMM_BLOCK_DEPTH);
+                        for (size_t jj = 0; jj < n; jj += GEMM_BLOCK_COLS) {
+                            size_t jEnd = std::min(n, jj + GEMM_BLOCK_COLS);
+                            for (size_t i = ii; i < iEnd; i++) {
+                                const auto *a = aRow(i);
+                                R *c = cRow(i);
+                                for (size_t p = pp; p < pEnd; p++) {
+                                    const auto aip = a[p];
+                                    const auto *b = bRow(p);
+                                    for (size_t j = jj; j < jEnd; j++) {
+                                        c[j] += product(aip, b[j]);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        /*
+         * y[first..last) = A[first..last) * x
+         */
+        template<typename R, typename A, typename B, typename ARows>
+        void gemvRows(size_t first, size_t last, size_t n, ARows aRow,
+                      const B *x, R *y) {
+            MtmCpu::dispatchFor<R>([&] {
+                for (size_t i = first; i < last; i++) {
+                    const A *row = aRow(i);
+                    R acc[2] = {R(), R()};
+                    size_t j = 0;
+                    for (; j + 2 <= n; j += 2) {
+                        acc[0] += product(row[j], x[j]);
+                        acc[1] += product(row[j + 1], x[j + 1]);
+                    }
+                    for (; j < n; j++) {
+                        acc[0] += product(row[j], x[j]);
+                    }
+                    y[i] = acc[0] + acc[1];
+                }
+            });
+        }
+
+        /*
+         * y[first..last) = (x^T * A)[first..last), A has m rows
+         */
+        template<typename R, typename B, typename A, typename BRows>
+        void gemvTransCols(size_t first, size_t last, size_t m, BRows bRow,
+                           const A *x, R *y) {
+            MtmCpu::dispatchFor<R>([&] {
+                for (size_t j = first; j < last; j++) {
+                    y[j] = R();
+                }
+                for (size_t i = 0; i < m; i++) {
+                    const B *row = bRow(i);
+                    const A scale = x[i];
+                    for (size_t j = first; j < last; j++) {
+                        y[j] += product(scale, row[j]);
+                    }
+                }
+            });
+        }
+
+    }
+
+    //MATRIX PRODUCTS
+
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmMat<MtmMixedOps::Promoted<A, B>> operator*(const MtmMat<A> &a,
+                                                  const MtmMat<B> &b) {
+        typedef MtmMixedOps::Promoted<A, B> R;
+        if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   b.getDimensions());
+        }
+        size_t m = (size_t) a.getDimensions().getRow();
+        size_t n = (size_t) b.getDimensions().getCol();
+        size_t k = (size_t) a.getDimensions().getCol();
+        MTM_STATS_OPERATION(MAT_MULTIPLY, 2ULL * m * n * k);
+
+        MtmMat<R> c = MtmMat<R>(Dimensions(m, n), R());
+        auto rowsBody = [&](size_t first, size_t last) {
+            MtmMixedOps::gemm<R>(
+                    last - first, n, k,
+                    [&a, first](size_t i) {
+                        return a[(index_t) (first + i)].data();
+                    },
+                    MtmKernels::MatRows<const MtmMat<B>, const B>(b),
+                    [&c, first](size_t i) {
+                        return c[(index_t) (first + i)].data();
+                    });
+        };
+        if (m * n * k < MtmKernels::GEMM_PARALLEL_THRESHOLD) {
+            rowsBody(0, m);
+        } else {
+            MtmScheduler::placedFor(0, m, MtmKernels::GEMM_BLOCK_ROWS,
+                                    rowsBody);
+        }
+        return c;
+    }
+
+    /*
+     * Matrix times column vector of another element type
+     */
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmVec<MtmMixedOps::Promoted<A, B>> operator*(const MtmMat<A> &a,
+                                                  const MtmVec<B> &x) {
+        typedef MtmMixedOps::Promoted<A, B> R;
+        if (x.getDimensions() !=
+            Dimensions((size_t) a.getDimensions().getCol(), 1)) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   x.getDimensions());
+        }
+        size_t m = (size_t) a.getDimensions().getRow();
+        size_t n = (size_t) a.getDimensions().getCol();
+        MTM_STATS_OPERATION(MAT_VEC_MULTIPLY, 2 * m * n);
+
+        MtmVec<R> result = MtmVec<R>(m, R());
+        MtmKernels::MatRows<const MtmMat<A>, const A> aRow(a);
+        const B *in = x.data();
+        R *out = result.data();
+        if (m * n < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+            MtmMixedOps::gemvRows<R, A>(0, m, n, aRow, in, out);
+            return result;
+        }
+        MtmScheduler::placedFor(
+                0, m, MtmKernels::GEMV_PARALLEL_THRESHOLD / n + 1,
+                [&](size_t first, size_t last) {
+                    MtmMixedOps::gemvRows<R, A>(first, last, n, aRow, in,
+                                                out);
+                });
+        return result;
+    }
+
+    /*
+     * Row vector times matrix of another element type
+     */
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmVec<MtmMixedOps::Promoted<A, B>> operator*(const MtmVec<A> &x,
+                                                  const MtmMat<B> &a) {
+        typedef MtmMixedOps::Promoted<A, B> R;
+        if (x.getDimensions() !=
+            Dimensions(1, (size_t) a.getDimensions().getRow())) {
+            throw MtmExceptions::DimensionMismatch(x.getDimensions(),
+                                                   a.getDimensions());
+        }
+        size_t m = (size_t) a.getDimensions().getRow();
+        size_t n = (size_t) a.getDimensions().getCol();
+        MTM_STATS_OPERATION(VEC_MAT_MULTIPLY, 2 * m * n);
+
+        MtmVec<R> result = MtmVec<R>(n, R());
+        result.transpose();
+        MtmKernels::MatRows<const MtmMat<B>, const B> aRow(a);
+        const A *in = x.data();
+        R *out = result.data();
+        if (m * n < MtmKernels::GEMV_PARALLEL_THRESHOLD) {
+            MtmMixedOps::gemvTransCols<R, B>(0, n, m, aRow, in, out);
+            return result;
+        }
+        MtmScheduler::parallelFor(
+                0, n, MtmKernels::GEMV_PARALLEL_THRESHOLD / m + 1,
+                [&](size_t first, size_t last) {
+                    MtmMixedOps::gemvTransCols<R, B>(first, last, m, aRow,
+                                                     in, out);
+                });
+        return result;
+    }
+
+    /*
+     * Row vector times column vector, a one element vector like the same
+     * type product
+     */
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmVec<MtmMixedOps::Promoted<A, B>> operator*(const MtmVec<A> &a,
+                                                  const MtmVec<B> &b) {
+        typedef MtmMixedOps::Promoted<A, B> R;
+        if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   b.getDimensions());
+        }
+        size_t n = (size_t) a.getDimensions().getCol();
+        MTM_STATS_OPERATION(VEC_DOT, 2 * n);
+        const A *x = a.data();
+        const B *y = b.data();
+        R sum = R();
+        for (size_t i = 0; i < n; i++) {
+            sum += MtmMixedOps::product(x[i], y[i]);
+        }
+        return MtmVec<R>(1, sum);
+    }
+
+    //ELEMENT-WISE
+
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmMat<MtmMixedOps::Promoted<A, B>> operator+(const MtmMat<A> &a,
+                                                  const MtmMat<B> &b) {
+        MTM_STATS_OPERATION(MAT_ADD, a.getDimensions().getRow() *
+                                     a.getDimensions().getCol());
+        return zip(a, b, [](const A &x, const B &y) {
+            return MtmMixedOps::sum(x, y);
+        });
+    }
+
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmMat<MtmMixedOps::Promoted<A, B>> operator-(const MtmMat<A> &a,
+                                                  const MtmMat<B> &b) {
+        MTM_STATS_OPERATION(MAT_ADD, a.getDimensions().getRow() *
+                                     a.getDimensions().getCol());
+        return zip(a, b, [](const A &x, const B &y) {
+            return MtmMixedOps::difference(x, y);
+        });
+    }
+
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmVec<MtmMixedOps::Promoted<A, B>> operator+(const MtmVec<A> &a,
+                                                  const MtmVec<B> &b) {
+        MTM_STATS_OPERATION(VEC_ADD, a.size());
+        return zip(a, b, [](const A &x, const B &y) {
+            return MtmMixedOps::sum(x, y);
+        });
+    }
+
+    template<typename A, typename B, typename = MtmMixedOps::Mixed<A, B>>
+    MtmVec<MtmMixedOps::Promoted<A, B>> operator-(const MtmVec<A> &a,
+                                                  const MtmVec<B> &b) {
+        MTM_STATS_OPERATION(VEC_ADD, a.size());
+        return zip(a, b, [](const A &x, const B &y) {
+            return MtmMixedOps::difference(x, y);
+        });
+    }
+
+    //SCALARS
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmMat<MtmMixedOps::Promoted<S, T>> operator*(const S &num,
+                                                  const MtmMat<T> &a) {
+        MTM_STATS_OPERATION(MAT_SCALE, a.getDimensions().getRow() *
+                                       a.getDimensions().getCol());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::product(num, x);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmMat<MtmMixedOps::Promoted<T, S>> operator*(const MtmMat<T> &a,
+                                                  const S &num) {
+        MTM_STATS_OPERATION(MAT_SCALE, a.getDimensions().getRow() *
+                                       a.getDimensions().getCol());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::product(x, num);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmMat<MtmMixedOps::Promoted<T, S>> operator+(const MtmMat<T> &a,
+                                                  const S &num) {
+        MTM_STATS_OPERATION(MAT_SCALAR_ADD, a.getDimensions().getRow() *
+                                            a.getDimensions().getCol());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::sum(x, num);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmMat<MtmMixedOps::Promoted<S, T>> operator+(const S &num,
+                                                  const MtmMat<T> &a) {
+        return a + num;
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmMat<MtmMixedOps::Promoted<T, S>> operator-(const MtmMat<T> &a,
+                                                  const S &num) {
+        MTM_STATS_OPERATION(MAT_SCALAR_ADD, a.getDimensions().getRow() *
+                                            a.getDimensions().getCol());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::difference(x, num);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmMat<MtmMixedOps::Promoted<S, T>> operator-(const S &num,
+                                                  const MtmMat<T> &a) {
+        MTM_STATS_OPERATION(MAT_SCALAR_ADD, a.getDimensions().getRow() *
+                                            a.getDimensions().getCol());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::difference(num, x);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmVec<MtmMixedOps::Promoted<S, T>> operator*(const S &num,
+                                                  const MtmVec<T> &a) {
+        MTM_STATS_OPERATION(VEC_SCALE, a.size());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::product(num, x);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmVec<MtmMixedOps::Promoted<T, S>> operator*(const MtmVec<T> &a,
+                                                  const S &num) {
+        MTM_STATS_OPERATION(VEC_SCALE, a.size());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::product(x, num);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmVec<MtmMixedOps::Promoted<T, S>> operator+(const MtmVec<T> &a,
+                                                  const S &num) {
+        MTM_STATS_OPERATION(VEC_SCALAR_ADD, a.size());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::sum(x, num);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmVec<MtmMixedOps::Promoted<S, T>> operator+(const S &num,
+                                                  const MtmVec<T> &a) {
+        return a + num;
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmVec<MtmMixedOps::Promoted<T, S>> operator-(const MtmVec<T> &a,
+                                                  const S &num) {
+        MTM_STATS_OPERATION(VEC_SCALAR_ADD, a.size());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::difference(x, num);
+        });
+    }
+
+    template<typename S, typename T, typename = MtmMixedOps::Mixed<S, T>>
+    MtmVec<MtmMixedOps::Promoted<S, T>> operator-(const S &num,
+                                                  const MtmVec<T> &a) {
+        MTM_STATS_OPERATION(VEC_SCALAR_ADD, a.size());
+        return map(a, [num](const T &x) {
+            return MtmMixedOps::difference(num, x);
+        });
+    }
+
+}
+
+#endif //EX3_MTMMIXED_H
@@ -0,0 +1,452 @@
+#ifndef EX3_MTMMODINT_H
+#define EX3_MTMMODINT_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <iostream>
+#include <type_traits>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmScheduler.h"
+#include "MtmKernels.h"
+#include "MtmMat.h"
+#include "MtmMatSq.h"
+#include "MtmLU.h"
+
+using std::size_t;
+
+/*
+ * Integers modulo P for exact linear algebra over prime fields.
+ * ModInt<P> fixes the modulus at compile time, ModInt<0> reads it from
+ * ModInt<0>::setModulus() at run time (one modulus per program - set it
+ * before building matrices and do not change it while they are in use).
+ * The modulus has to be in [2, 2^31). Values are kept in [0, P) and
+ * products are reduced with Barrett reduction (for a compile time P the
+ * compiler already turns % into the same multiply-shift).
+ * MtmMat products (through multiplyInto) and LUDecomposition of ModInt
+ * matrices do not reduce per element operation: products are summed raw
+ * in 64 bits and reduced once every lazyTerms() terms, which stays exact
+ * and lets the compiler vectorize the inner loop like a plain integer
+ * GEMM. Division and LU pivots need invertible elements, so P should be
+ * prime.
+ */
+
+namespace MtmMath {
+
+    namespace MtmModIntOps {
+
+        /*
+         * x mod m for any 64 bit x, with inverse = floor((2^64 - 1) / m).
+         * The quotient estimate is off by at most one, so one conditional
+         * subtraction finishes it.
+         */
+        struct Barrett {
+            uint32_t m;
+            uint64_t inverse;
+
+            uint32_t reduce(uint64_t x) const {
+                uint64_t q = (uint64_t) (((unsigned __int128) x * inverse)
+                        >> 64);
+                uint64_t r = x - q * m;
+                return (uint32_t) (r >= m ? r - m : r);
+            }
+        };
+
+        inline Barrett &runtimeModulus() {
+            static Barrett modulus = {2, std::numeric_limits<uint64_t>::max()
+                                         / 2};
+            return modulus;
+        }
+    }
+
+    template<uint32_t P>
+    class ModInt {
+        static_assert(P == 0 || (P >= 2 && P < (1u << 31)),
+                      "ModInt modulus has to be in [2, 2^31)");
+        uint32_t v;
+
+    public:
+        /*
+         * Exact: the value is not reduced again
+         */
+        struct Raw {
+        };
+
+        ModInt() : v(0) {
+        }
+
+        ModInt(uint32_t value, Raw) : v(value) {
+        }
+
+        template<typename I, typename = typename std::enable_if<
+                std::is_integral<I>::value>::type>
+        ModInt(I value) {
+            if (std::is_signed<I>::value && value < 0) {
+                uint64_t magnitude = reduce(0 - (uint64_t) (int64_t) value);
+                v = magnitude == 0 ? 0 : modulus() - (uint32_t) magnitude;
+            } else {
+                v = reduce((uint64_t) value);
+            }
+        }
+
+        ModInt(const ModInt &toCopy) = default;
+
+        ModInt &operator=(const ModInt &c) = default;
+
+        static uint32_t modulus() {
+            if constexpr (P != 0) {
+                return P;
+            } else {
+                return MtmModIntOps::runtimeModulus().m;
+            }
+        }
+
+        /*
+         * Only for ModInt<0>
+         */
+        static void setModulus(uint32_t m) {
+            static_assert(P == 0, "the modulus of ModInt<P> is fixed");
+            if (m < 2 || m >= (1u << 31)) {
+                throw MtmExceptions::IllegalInitialization();
+            }
+            MtmModIntOps::runtimeModulus() = MtmModIntOps::Barrett{
+                    m, std::numeric_limits<uint64_t>::max() / m};
+        }
+
+        static uint32_t reduce(uint64_t x) {
+            if constexpr (P != 0) {
+                return (uint32_t) (x % P);
+            } else {
+                return MtmModIntOps::runtimeModulus().reduce(x);
+            }
+        }
+
+        /*
+         * How many products of two reduced values fit in a 64 bit sum that
+         * starts below the modulus
+         */
+        static uint64_t lazyTerms() {
+            uint64_t largest = modulus() - 1;
+            return (std::numeric_limits<uint64_t>::max() - modulus()) /
+                   (largest * largest);
+        }
+
+        uint32_t value() const {
+            return v;
+        }
+
+        std::string to_string() const {
+            return std::to_string(v);
+        }
+
+        ModInt &operator+=(const ModInt &c) {
+            v += c.v;
+            if (v >= modulus()) {
+                v -= modulus();
+            }
+            return *this;
+        }
+
+        ModInt &operator-=(const ModInt &c) {
+            v = v >= c.v ? v - c.v : v + modulus() - c.v;
+            return *this;
+        }
+
+        ModInt &operator*=(const ModInt &c) {
+            v = reduce((uint64_t) v * c.v);
+            return *this;
+        }
+
+        ModInt &operator/=(const ModInt &c) {
+            return *this *= c.inverse();
+        }
+
+        ModInt operator-() const {
+            return ModInt(v == 0 ? 0 : modulus() - v, Raw());
+        }
+
+        /*
+         * Multiplicative inverse by the extended Euclid algorithm, throws
+         * SingularMatrix when there is none (zero, or P not prime)
+         */
+        ModInt inverse() const {
+            int64_t a = v, b = modulus(), x = 1, y = 0;
+            while (b != 0) {
+                int64_t q = a / b;
+                int64_t nextB = a - q * b, nextY = x - q * y;
+                a = b;
+                b = nextB;
+                x = y;
+                y = nextY;
+            }
+            if (a != 1) {
+                throw MtmExceptions::SingularMatrix();
+            }
+            return ModInt(x);
+        }
+
+        ModInt pow(uint64_t e) const {
+            ModInt result = ModInt(1), base = *this;
+            for (; e != 0; e >>= 1) {
+                if (e & 1) {
+                    result *= base;
+                }
+                base *= base;
+            }
+            return result;
+        }
+
+        bool operator==(const ModInt &c) const {
+            return v == c.v;
+        }
+
+        bool operator!=(const ModInt &c) const {
+            return v != c.v;
+        }
+    };
+
+    template<uint32_t P>
+    ModInt<P> operator+(ModInt<P> a, const ModInt<P> &b) {
+        return a += b;
+    }
+
+    template<uint32_t P>
+    ModInt<P> operator-(ModInt<P> a, const ModInt<P> &b) {
+        return a -= b;
+    }
+
+    template<uint32_t P>
+    ModInt<P> operator*(ModInt<P> a, const ModInt<P> &b) {
+        return a *= b;
+    }
+
+    template<uint32_t P>
+    ModInt<P> operator/(ModInt<P> a, const ModInt<P> &b) {
+        return a /= b;
+    }
+
+    template<uint32_t P>
+    std::ostream &operator<<(std::ostream &os, const ModInt<P> &x) {
+        return os << x.value();
+    }
+
+    /*
+     * Any non zero pivot is exact, so LU takes the first one
+     */
+    template<uint32_t P>
+    double pivotMagnitude(const ModInt<P> &x) {
+        return x.value() != 0 ? 1 : 0;
+    }
+
+    namespace MtmModIntOps {
+
+        /*
+         * c[0..n) = sum over p < count of a(p) * bRow(p)[0..n), reduced.
+         * acc is scratch of n elements. Sums are reduced only every
+         * lazyTerms() products.
+         */
+        template<uint32_t P, typename ACoef, typename BRows>
+        void lazyCombine(size_t count, size_t n, ACoef a, BRows bRow,
+                         uint64_t *acc, ModInt<P> *c) {
+            typedef ModInt<P> M;
+            const uint64_t terms = M::lazyTerms();
+            std::fill(acc, acc + n, 0);
+            size_t pending = 0;
+            for (size_t p = 0; p < count; p++) {
+                const uint64_t scale = a(p);
+                const M *b = bRow(p);
+                if (scale != 0) {
+                    for (size_t j = 0; j < n; j++) {
+                        acc[j] += scale * b[j].value();
+                    }
+                    pending++;
+                }
+                if (pending == terms) {
+                    for (size_t j = 0; j < n; j++) {
+                        acc[j] = M::reduce(acc[j]);
+                    }
+                    pending = 0;
+                }
+            }
+            for (size_t j = 0; j < n; j++) {
+                c[j] = M(M::reduce(acc[j]), typename M::Raw());
+            }
+        }
+
+        /*
+         * C = A * B on row accessors, columns of C done GEMM_BLOCK_COLS at
+         * a time so one 64 bit accumulator row stays in L1
+         */
+        template<uint32_t P, typename ARows, typename BRows, typename CRows>
+        void lazyGemmRows(size_t first, size_t last, size_t n, size_t k,
+                          ARows aRow, BRows bRow, CRows cRow) {
+            typedef ModInt<P> M;
+            std::vector<uint64_t> acc(
+                    std::min(n, MtmKernels::GEMM_BLOCK_COLS));
+            for (size_t jj = 0; jj < n; jj += MtmKernels::GEMM_BLOCK_COLS) {
+                size_t width = std::min(n - jj, MtmKernels::GEMM_BLOCK_COLS);
+                for (size_t i = first; i < last; i++) {
+                    const M *a = aRow(i);
+                    lazyCombine<P>(k, width,
+                                   [a](size_t p) {
+                                       return (uint64_t) a[p].value();
+                                   },
+                                   [&bRow, jj](size_t p) {
+                                       return bRow(p) + jj;
+                                   },
+                                   acc.data(), cRow(i) + jj);
+                }
+            }
+        }
+
+        template<uint32_t P, typename Body>
+        void splitRows(size_t rows, size_t work, Body body) {
+            if (work < MtmKernels::GEMM_PARALLEL_THRESHOLD) {
+                body(0, rows);
+                return;
+            }
+            MtmScheduler::parallelFor(
+                    0, rows, MtmKernels::GEMM_PARALLEL_THRESHOLD / 4 /
+                             (work / rows + 1) + 1, body);
+        }
+
+        //LU panel width, the trailing update is a lazy GEMM of this depth
+        const size_t LU_BLOCK = 64;
+    }
+
+    /*
+     * Blocked right looking LU with the same result layout as the
+     * generic LUDecomposition: each panel of LU_BLOCK columns is
+     * eliminated element-wise, the trailing matrix gets one lazily
+     * reduced update per panel. Returns the number of row swaps.
+     */
+    template<uint32_t P>
+    int luFactorize(MtmMatSq<ModInt<P>> &factors,
+                    std::vector<size_t> &pivots) {
+        typedef ModInt<P> M;
+        size_t n = pivots.size();
+        int swaps = 0;
+        std::vector<M> update(n);
+        for (size_t kb = 0; kb < n; kb += MtmModIntOps::LU_BLOCK) {
+            size_t kEnd = std::min(n, kb + MtmModIntOps::LU_BLOCK);
+
+            //panel, rows [kb, n) and columns [kb, kEnd)
+            for (size_t k = kb; k < kEnd; k++) {
+                size_t best = k;
+                while (best < n &&
+                       factors[(index_t) best].data()[k] == M()) {
+                    best++;
+                }
+                if (best == n) {
+                    throw MtmExceptions::SingularMatrix();
+                }
+                if (best != k) {
+                    factors[(index_t) k].swap(factors[(index_t) best]);
+                    std::swap(pivots[k], pivots[best]);
+                    swaps++;
+                }
+                const M *pivotRow = factors[(index_t) k].data();
+                const M inverse = pivotRow[k].inverse();
+                for (size_t i = k + 1; i < n; i++) {
+                    M *row = factors[(index_t) i].data();
+                    if (row[k] == M()) {
+                        continue;
+                    }
+                    const M factor = row[k] * inverse;
+                    row[k] = factor;
+                    for (size_t j = k + 1; j < kEnd; j++) {
+                        row[j] -= factor * pivotRow[j];
+                    }
+                }
+            }
+            if (kEnd == n) {
+                break;
+            }
+
+            //row i of [kEnd, n) minus the first `depth` columns of its
+            //panel part times the matching rows of U12
+            size_t width = n - kEnd;
+            auto updateRow = [&factors, kb, kEnd, width](
+                    size_t i, size_t depth, uint64_t *acc, M *sum) {
+                M *row = factors[(index_t) i].data();
+                MtmModIntOps::lazyCombine<P>(
+                        depth, width,
+                        [row, kb](size_t p) {
+                            return (uint64_t) row[kb + p].value();
+                        },
+                        [&factors, kb, kEnd](size_t p) {
+                            return (const M *) factors[(index_t) (kb + p)].data()
+                                   + kEnd;
+                        },
+                        acc, sum);
+                for (size_t j = 0; j < width; j++) {
+                    row[kEnd + j] -= sum[j];
+                }
+            };
+
+            //U12 = L11^-1 * A12
+            std::vector<uint64_t> acc(width);
+            for (size_t i = kb + 1; i < kEnd; i++) {
+                updateRow(i, i - kb, acc.data(), update.data());
+            }
+
+            //A22 -= L21 * U12
+            MtmModIntOps::splitRows<P>(
+                    n - kEnd, (n - kEnd) * width * (kEnd - kb),
+                    [&updateRow, kb, kEnd, width](size_t first, size_t last) {
+                        std::vector<uint64_t> rowAcc(width);
+                        std::vector<M> sum(width);
+                        for (size_t i = kEnd + first; i < kEnd + last; i++) {
+                            updateRow(i, kEnd - kb, rowAcc.data(),
+                                      sum.data());
+                        }
+                    });
+        }
+        return swaps;
+    }
+
+    /*
+     * Matrix product over Z/P with lazily reduced 64 bit sums, used by
+     * MtmMat * MtmMat for ModInt elements
+     */
+    template<uint32_t P>
+    void multiplyInto(const MtmMat<ModInt<P>> &a, const MtmMat<ModInt<P>> &b,
+                      MtmMat<ModInt<P>> &c) {
+        typedef ModInt<P> M;
+        if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   b.getDimensions());
+        }
+        Dimensions resultDimensions = Dimensions(a.getDimensions().getRow(),
+                                                 b.getDimensions().getCol());
+        if (c.getDimensions() != resultDimensions) {
+            throw MtmExceptions::DimensionMismatch(resultDimensions,
+                                                   c.getDimensions());
+        }
+        if (&c == &a || &c == &b) {
+            MtmMat<M> result = MtmMat<M>(resultDimensions, M());
+            multiplyInto(a, b, result);
+            c = std::move(result);
+            return;
+        }
+        size_t m = (size_t) a.getDimensions().getRow();
+        size_t n = (size_t) b.getDimensions().getCol();
+        size_t k = (size_t) a.getDimensions().getCol();
+        MTM_STATS_OPERATION(MAT_MULTIPLY, 2ULL * m * n * k);
+
+        MtmKernels::MatRows<const MtmMat<M>, const M> aRow(a);
+        MtmKernels::MatRows<const MtmMat<M>, const M> bRow(b);
+        MtmKernels::MatRows<MtmMat<M>, M> cRow(c);
+        MtmModIntOps::splitRows<P>(m, m * n * k,
+                                   [&](size_t first, size_t last) {
+            MtmModIntOps::lazyGemmRows<P>(first, last, n, k, aRow, bRow,
+                                          cRow);
+        });
+    }
+
+}
+
+#endif //EX3_MTMMODINT_H
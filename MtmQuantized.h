@@ -0,0 +1,454 @@
+#ifndef EX3_MTMQUANTIZED_H
+#define EX3_MTMQUANTIZED_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmScheduler.h"
+#include "MtmCpu.h"
+#include "MtmMat.h"
+
+#if defined(MTM_CPU_DISPATCH) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using std::size_t;
+
+/*
+ * Integer GEMM for quantized data stored as MtmMat<int8_t> or
+ * MtmMat<int16_t> (a quarter / half of the memory of MtmMat<int>).
+ * Products are summed in 32 bits with pmaddwd (_mm256_madd_epi16 with
+ * AVX2, _mm_madd_epi16 with SSE2, plain loops otherwise, picked at run
+ * time from MtmCpu::isaLevel()): B is packed as
+ * interleaved pairs along k and every instruction does 16 (8 with SSE2)
+ * multiply-adds. int8 inputs are widened to int16 while packing, so the
+ * result is exact - pmaddubsw is not used because its 16 bit saturation
+ * loses exactness for full range int8 inputs.
+ * A 32 bit sum can wrap once k * max|a| * max|b| reaches 2^31: full
+ * range int16 inputs from k = 2 on (-32768 * -32768 * 2 = 2^31), full
+ * range int8 inputs from k = 2^17.
+ * quantize / requantize / dequantize / saturateCast convert between real
+ * values, 32 bit accumulators and the narrow types with an affine
+ * scale and zero point and saturate instead of wrapping.
+ */
+
+namespace MtmMath {
+
+    //below this many multiply-adds a quantized product stays serial
+    const size_t QUANTIZED_PARALLEL_THRESHOLD = 1 << 18;
+
+    namespace MtmQuantizedOps {
+
+#if defined(MTM_CPU_DISPATCH) || defined(__AVX2__)
+#define MTM_QUANTIZED_AVX2 1
+#endif
+
+        enum PanelKernel {
+            PANEL_SCALAR,
+            PANEL_SSE2,
+            PANEL_AVX2
+        };
+
+        //rows of C done per panel, as many as the registers hold
+        constexpr size_t PANEL_ROWS[] = {4, 2, 4};
+        //columns of C done per panel, multiple of every vector width
+        const size_t PANEL_COLS = 16;
+        //k pairs per block, keeps a 16 column strip of B in L1
+        const size_t DEPTH_BLOCK = 256;
+
+        /*
+         * Operands widened to int16. pairs[p] of row i of A is
+         * (A(i, 2p), A(i, 2p + 1)); B holds, for every k pair p and column
+         * j, (B(2p, j), B(2p + 1, j)) next to each other so one load gives
+         * the pairs of 8/16 columns. Odd k and ragged n are zero padded.
+         */
+        struct Packed {
+            size_t m;
+            size_t n;
+            size_t kPairs;
+            size_t nPadded;
+            std::vector<int16_t> a;
+            std::vector<int16_t> b;
+            std::vector<int32_t> c;
+        };
+
+        template<typename Q>
+        void pack(const MtmMat<Q> &a, const MtmMat<Q> &b, Packed &packed) {
+            size_t m = (size_t) a.getDimensions().getRow();
+            size_t k = (size_t) a.getDimensions().getCol();
+            size_t n = (size_t) b.getDimensions().getCol();
+            packed.m = m;
+            packed.n = n;
+            packed.kPairs = (k + 1) / 2;
+            packed.nPadded = (n + PANEL_COLS - 1) / PANEL_COLS * PANEL_COLS;
+            size_t kPadded = 2 * packed.kPairs;
+            try {
+                packed.a.assign(m * kPadded, 0);
+                packed.b.assign(kPadded * packed.nPadded, 0);
+                packed.c.assign(m * packed.nPadded, 0);
+            }
+            catch (std::bad_alloc &e) {
+                throw MtmExceptions::OutOfMemory();
+            }
+            for (size_t i = 0; i < m; i++) {
+                const Q *row = a[(index_t) i].data();
+                std::copy(row, row + k, packed.a.data() + i * kPadded);
+            }
+            for (size_t p = 0; p < k; p++) {
+                const Q *row = b[(index_t) p].data();
+                int16_t *out = packed.b.data() +
+                               (p / 2) * 2 * packed.nPadded + p % 2;
+                for (size_t j = 0; j < n; j++) {
+                    out[2 * j] = row[j];
+                }
+            }
+        }
+
+        inline int32_t pairAt(const int16_t *pairs, size_t p) {
+            int32_t pair;
+            std::memcpy(&pair, pairs + 2 * p, sizeof(pair));
+            return pair;
+        }
+
+        /*
+         * Pointers to the panel of C[rows, PANEL_COLS columns at col] and
+         * the A rows / B pairs it is built from
+         */
+        struct PanelView {
+            const int16_t *a;
+            const int16_t *b;
+            int32_t *c;
+            size_t aStride;
+            size_t bStride;
+            size_t cStride;
+
+            PanelView(Packed &packed, size_t row, size_t col)
+                    : a(packed.a.data() + row * 2 * packed.kPairs),
+                      b(packed.b.data() + 2 * col),
+                      c(packed.c.data() + row * packed.nPadded + col),
+                      aStride(2 * packed.kPairs), bStride(2 * packed.nPadded),
+                      cStride(packed.nPadded) {}
+        };
+
+        /*
+         * C panel += A * B over k pairs [first, last), with all of the
+         * panel's sums in registers
+         */
+        template<size_t ROWS>
+        void panelScalar(Packed &packed, size_t row, size_t col,
+                         size_t first, size_t last) {
+            PanelView view(packed, row, col);
+            for (size_t r = 0; r < ROWS; r++) {
+                int32_t *out = view.c + r * view.cStride;
+                const int16_t *pairs = view.a + r * view.aStride;
+                for (size_t p = first; p < last; p++) {
+                    int32_t a0 = pairs[2 * p];
+                    int32_t a1 = pairs[2 * p + 1];
+                    const int16_t *in = view.b + p * view.bStride;
+                    //summed in uint32_t, so it wraps like pmaddwd / paddd
+                    //instead of overflowing a signed int
+                    for (size_t j = 0; j < PANEL_COLS; j++) {
+                        out[j] = (int32_t) ((uint32_t) out[j] +
+                                            (uint32_t) (a0 * in[2 * j]) +
+                                            (uint32_t) (a1 * in[2 * j + 1]));
+                    }
+                }
+            }
+        }
+
+#if defined(__SSE2__)
+        template<size_t ROWS>
+        void panelSse2(Packed &packed, size_t row, size_t col,
+                       size_t first, size_t last) {
+            PanelView view(packed, row, col);
+            __m128i acc[ROWS][4];
+            for (size_t r = 0; r < ROWS; r++) {
+                const __m128i *in = (const __m128i *) (view.c +
+                                                       r * view.cStride);
+                for (size_t v = 0; v < 4; v++) {
+                    acc[r][v] = _mm_loadu_si128(in + v);
+                }
+            }
+            for (size_t p = first; p < last; p++) {
+                const __m128i *pairs = (const __m128i *) (view.b +
+                                                          p * view.bStride);
+                __m128i bv[4];
+                for (size_t v = 0; v < 4; v++) {
+                    bv[v] = _mm_loadu_si128(pairs + v);
+                }
+                for (size_t r = 0; r < ROWS; r++) {
+                    __m128i scale = _mm_set1_epi32(
+                            pairAt(view.a + r * view.aStride, p));
+                    for (size_t v = 0; v < 4; v++) {
+                        acc[r][v] = _mm_add_epi32(
+                                acc[r][v], _mm_madd_epi16(scale, bv[v]));
+                    }
+                }
+            }
+            for (size_t r = 0; r < ROWS; r++) {
+                __m128i *out = (__m128i *) (view.c + r * view.cStride);
+                for (size_t v = 0; v < 4; v++) {
+                    _mm_storeu_si128(out + v, acc[r][v]);
+                }
+            }
+        }
+#endif
+
+#if defined(MTM_QUANTIZED_AVX2)
+        template<size_t ROWS>
+        MTM_TARGET(MTM_ISA_AVX2)
+        void panelAvx2(Packed &packed, size_t row, size_t col,
+                       size_t first, size_t last) {
+            PanelView view(packed, row, col);
+            __m256i acc[ROWS][2];
+            for (size_t r = 0; r < ROWS; r++) {
+                const __m256i *in = (const __m256i *) (view.c +
+                                                       r * view.cStride);
+                acc[r][0] = _mm256_loadu_si256(in);
+                acc[r][1] = _mm256_loadu_si256(in + 1);
+            }
+            for (size_t p = first; p < last; p++) {
+                const __m256i *pairs = (const __m256i *) (view.b +
+                                                          p * view.bStride);
+                __m256i b0 = _mm256_loadu_si256(pairs);
+                __m256i b1 = _mm256_loadu_si256(pairs + 1);
+                for (size_t r = 0; r < ROWS; r++) {
+                    __m256i scale = _mm256_set1_epi32(
+                            pairAt(view.a + r * view.aStride, p));
+                    acc[r][0] = _mm256_add_epi32(
+                            acc[r][0], _mm256_madd_epi16(scale, b0));
+                    acc[r][1] = _mm256_add_epi32(
+                            acc[r][1], _mm256_madd_epi16(scale, b1));
+                }
+            }
+            for (size_t r = 0; r < ROWS; r++) {
+                __m256i *out = (__m256i *) (view.c + r * view.cStride);
+                _mm256_storeu_si256(out, acc[r][0]);
+                _mm256_storeu_si256(out + 1, acc[r][1]);
+            }
+        }
+#endif
+
+        /*
+         * Widest panel kernel this build and the selected level allow
+         */
+        inline PanelKernel panelKernel() {
+#if defined(MTM_CPU_DISPATCH)
+            if (MtmCpu::isaLevel() >= MtmCpu::ISA_AVX2) {
+                return PANEL_AVX2;
+            }
+#elif defined(__AVX2__)
+            return PANEL_AVX2;
+#endif
+#if defined(__SSE2__)
+            return PANEL_SSE2;
+#else
+            return PANEL_SCALAR;
+#endif
+        }
+
+        typedef void (*Panel)(Packed &, size_t, size_t, size_t, size_t);
+
+        /*
+         * Rows [first, last) of C, ROWS at a time except at the bottom of
+         * the matrix
+         */
+        template<size_t ROWS>
+        void multiplyRows(Packed &packed, size_t first, size_t last,
+                          Panel full, Panel single) {
+            for (size_t pp = 0; pp < packed.kPairs; pp += DEPTH_BLOCK) {
+                size_t pEnd = std::min(packed.kPairs, pp + DEPTH_BLOCK);
+                for (size_t j = 0; j < packed.nPadded; j += PANEL_COLS) {
+                    size_t i = first;
+                    for (; i + ROWS <= last; i += ROWS) {
+                        full(packed, i, j, pp, pEnd);
+                    }
+                    for (; i < last; i++) {
+                        single(packed, i, j, pp, pEnd);
+                    }
+                }
+            }
+        }
+
+        inline void multiplyRows(PanelKernel kernel, Packed &packed,
+                                 size_t first, size_t last) {
+            switch (kernel) {
+#if defined(MTM_QUANTIZED_AVX2)
+                case PANEL_AVX2:
+                    multiplyRows<PANEL_ROWS[PANEL_AVX2]>(
+                            packed, first, last,
+                            panelAvx2<PANEL_ROWS[PANEL_AVX2]>, panelAvx2<1>);
+                    return;
+#endif
+#if defined(__SSE2__)
+                case PANEL_SSE2:
+                    multiplyRows<PANEL_ROWS[PANEL_SSE2]>(
+                            packed, first, last,
+                            panelSse2<PANEL_ROWS[PANEL_SSE2]>, panelSse2<1>);
+                    return;
+#endif
+                default:
+                    multiplyRows<PANEL_ROWS[PANEL_SCALAR]>(
+                            packed, first, last,
+                            panelScalar<PANEL_ROWS[PANEL_SCALAR]>,
+                            panelScalar<1>);
+            }
+        }
+
+        template<typename Q>
+        MtmMat<int32_t> multiply(const MtmMat<Q> &a, const MtmMat<Q> &b) {
+            if (a.getDimensions().getCol() != b.getDimensions().getRow()) {
+                throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                       b.getDimensions());
+            }
+            Packed packed;
+            pack(a, b, packed);
+            size_t m = packed.m;
+            size_t n = packed.n;
+            size_t work = m * packed.nPadded * packed.kPairs * 2;
+            MTM_STATS_OPERATION(QUANTIZED_MULTIPLY,
+                                2 * m * n * a.getDimensions().getCol());
+
+            PanelKernel kernel = panelKernel();
+            const size_t rows = PANEL_ROWS[kernel];
+            if (work < QUANTIZED_PARALLEL_THRESHOLD) {
+                multiplyRows(kernel, packed, 0, m);
+            } else {
+                size_t panels = (m + rows - 1) / rows;
+                size_t perPanel = work / panels + 1;
+                MtmScheduler::parallelFor(
+                        0, panels,
+                        QUANTIZED_PARALLEL_THRESHOLD / 4 / perPanel + 1,
+                        [&packed, m, kernel, rows](size_t first,
+                                                   size_t last) {
+                            multiplyRows(kernel, packed, first * rows,
+                                         std::min(m, last * rows));
+                        });
+            }
+
+            MtmMat<int32_t> result = MtmMat<int32_t>(Dimensions(m, n), 0);
+            for (size_t i = 0; i < m; i++) {
+                const int32_t *row = packed.c.data() + i * packed.nPadded;
+                std::copy(row, row + n, result[(index_t) i].data());
+            }
+            return result;
+        }
+
+        template<typename To, typename From, typename F>
+        MtmMat<To> convert(const MtmMat<From> &in, F f) {
+            size_t rows = (size_t) in.getDimensions().getRow();
+            size_t cols = (size_t) in.getDimensions().getCol();
+            MtmMat<To> result = MtmMat<To>(in.getDimensions(), To());
+            for (size_t i = 0; i < rows; i++) {
+                const From *row = in[(index_t) i].data();
+                To *out = result[(index_t) i].data();
+                for (size_t j = 0; j < cols; j++) {
+                    out[j] = f(row[j]);
+                }
+            }
+            return result;
+        }
+    }
+
+    /*
+     * Clamps to the range of Q instead of wrapping. The bounds are
+     * compared as long double, which holds every value of Q and V, so
+     * signed / unsigned mixes (saturate<uint32_t>(-5)) clamp correctly.
+     * NaN has no nearest value and becomes 0.
+     */
+    template<typename Q, typename V>
+    Q saturate(V value) {
+        static_assert(std::is_integral<Q>::value,
+                      "saturate needs an integer target type");
+        const long double wide = (long double) value;
+        if (wide != wide) {
+            return Q();
+        }
+        if (wide <= (long double) std::numeric_limits<Q>::min()) {
+            return std::numeric_limits<Q>::min();
+        }
+        if (wide >= (long double) std::numeric_limits<Q>::max()) {
+            return std::numeric_limits<Q>::max();
+        }
+        return (Q) value;
+    }
+
+    /*
+     * A * B with 32 bit accumulation
+     */
+    inline MtmMat<int32_t> multiplyQuantized(const MtmMat<int8_t> &a,
+                                             const MtmMat<int8_t> &b) {
+        return MtmQuantizedOps::multiply(a, b);
+    }
+
+    inline MtmMat<int32_t> multiplyQuantized(const MtmMat<int16_t> &a,
+                                             const MtmMat<int16_t> &b) {
+        return MtmQuantizedOps::multiply(a, b);
+    }
+
+    /*
+     * Narrows an integer matrix (e.g. an existing MtmMat<int>) to Q
+     */
+    template<typename Q, typename T>
+    MtmMat<Q> saturateCast(const MtmMat<T> &in) {
+        return MtmQuantizedOps::convert<Q>(in, [](T x) {
+            return saturate<Q>(x);
+        });
+    }
+
+    /*
+     * q = round(x / scale) + zeroPoint, saturated to Q. NaN is quantized
+     * like 0, to zeroPoint.
+     */
+    template<typename Q, typename T>
+    MtmMat<Q> quantize(const MtmMat<T> &in, double scale, int zeroPoint = 0) {
+        if (!(scale > 0)) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        double inverse = 1 / scale;
+        return MtmQuantizedOps::convert<Q>(in, [inverse, zeroPoint](T x) {
+            if (x != x) {
+                return saturate<Q>(zeroPoint);
+            }
+            return saturate<Q>(std::nearbyint((double) x * inverse) +
+                               zeroPoint);
+        });
+    }
+
+    /*
+     * Maps 32 bit accumulators to the output type of the next layer,
+     * q = round(acc * scale) + zeroPoint saturated to Q. For
+     * C = A * B with scales sA, sB and output scale sC, scale is
+     * sA * sB / sC.
+     */
+    template<typename Q>
+    MtmMat<Q> requantize(const MtmMat<int32_t> &acc, double scale,
+                         int zeroPoint = 0) {
+        if (!(scale > 0)) {
+            throw MtmExceptions::IllegalInitialization();
+        }
+        return MtmQuantizedOps::convert<Q>(acc, [scale, zeroPoint](int32_t x) {
+            return saturate<Q>(std::nearbyint(x * scale) + zeroPoint);
+        });
+    }
+
+    /*
+     * x = (q - zeroPoint) * scale
+     */
+    template<typename T, typename Q>
+    MtmMat<T> dequantize(const MtmMat<Q> &in, double scale,
+                         int zeroPoint = 0) {
+        return MtmQuantizedOps::convert<T>(in, [scale, zeroPoint](Q q) {
+            return (T) (((double) q - zeroPoint) * scale);
+        });
+    }
+
+}
+
+#endif //EX3_MTMQUANTIZED_H
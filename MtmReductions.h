@@ -0,0 +1,614 @@
+#ifndef EX3_MTMREDUCTIONS_H
+#define EX3_MTMREDUCTIONS_H
+
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "MtmKernels.h"
+#include "MtmScheduler.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+namespace MtmMath {
+
+    //below this many elements a reduction stays on the calling thread
+    const size_t REDUCTION_PARALLEL_THRESHOLD = 1 << 16;
+    //elements per parallel chunk, each chunk has its own partial result
+    const size_t REDUCTION_CHUNK = 1 << 14;
+
+    enum ReductionType {
+        SUM,
+        NORM1,
+        NORM2,
+        NORM_INF,
+        MIN,
+        MAX
+    };
+
+    //ELEMENT SIZES
+
+    template<typename T>
+    double magnitude(const T &x) {
+        return x < T() ? (double) -x : (double) x;
+    }
+
+    inline double magnitude(const Complex &x) {
+        return std::sqrt(x.getReal() * x.getReal() +
+                         x.getImag() * x.getImag());
+    }
+
+    template<typename T>
+    double squaredMagnitude(const T &x) {
+        return (double) x * (double) x;
+    }
+
+    inline double squaredMagnitude(const Complex &x) {
+        return x.getReal() * x.getReal() + x.getImag() * x.getImag();
+    }
+
+    namespace MtmReductionOps {
+
+        /*
+         * Every reduction is described by how one element is added to an
+         * accumulator, how two accumulators merge and how the final
+         * accumulator turns into the result
+         */
+        template<typename T>
+        struct Sum {
+            typedef T Acc;
+
+            static void add(Acc &acc, const T &x) {
+                acc += x;
+            }
+
+            static void merge(Acc &acc, const Acc &other) {
+                acc += other;
+            }
+
+            static T finish(const Acc &acc) {
+                return acc;
+            }
+        };
+
+        template<typename T>
+        struct Norm1 {
+            typedef double Acc;
+
+            static void add(Acc &acc, const T &x) {
+                acc += magnitude(x);
+            }
+
+            static void merge(Acc &acc, const Acc &other) {
+                acc += other;
+            }
+
+            static double finish(const Acc &acc) {
+                return acc;
+            }
+        };
+
+        template<typename T>
+        struct Norm2 {
+            typedef double Acc;
+
+            static void add(Acc &acc, const T &x) {
+                acc += squaredMagnitude(x);
+            }
+
+            static void merge(Acc &acc, const Acc &other) {
+                acc += other;
+            }
+
+            static double finish(const Acc &acc) {
+                return std::sqrt(acc);
+            }
+        };
+
+        template<typename T>
+        struct NormInf {
+            typedef double Acc;
+
+            static void add(Acc &acc, const T &x) {
+                acc = std::max(acc, magnitude(x));
+            }
+
+            static void merge(Acc &acc, const Acc &other) {
+                acc = std::max(acc, other);
+            }
+
+            static double finish(const Acc &acc) {
+                return acc;
+            }
+        };
+
+        template<typename T>
+        struct Min {
+            typedef T Acc;
+
+            static void add(Acc &acc, const T &x) {
+                acc = x < acc ? x : acc;
+            }
+
+            static void merge(Acc &acc, const Acc &other) {
+                add(acc, other);
+            }
+
+            static T finish(const Acc &acc) {
+                return acc;
+            }
+        };
+
+        template<typename T>
+        struct Max {
+            typedef T Acc;
+
+            static void add(Acc &acc, const T &x) {
+                acc = acc < x ? x : acc;
+            }
+
+            static void merge(Acc &acc, const Acc &other) {
+                add(acc, other);
+            }
+
+            static T finish(const Acc &acc) {
+                return acc;
+            }
+        };
+
+        /*
+         * Reduces a contiguous array into acc. Four independent
+         * accumulators break the dependency chain so the loop vectorizes.
+         * init has to be neutral for the operation (zero for sums, any
+         * element of the array for min/max).
+         */
+        template<typename Op, typename T>
+        typename Op::Acc reduceArrayPortable(const T *x, size_t n,
+                                             const typename Op::Acc &init) {
+            typename Op::Acc acc[4] = {init, init, init, init};
+            size_t j = 0;
+            for (; j + 4 <= n; j += 4) {
+                Op::add(acc[0], x[j]);
+                Op::add(acc[1], x[j + 1]);
+                Op::add(acc[2], x[j + 2]);
+                Op::add(acc[3], x[j + 3]);
+            }
+            for (; j < n; j++) {
+                Op::add(acc[0], x[j]);
+            }
+            Op::merge(acc[0], acc[1]);
+            Op::merge(acc[2], acc[3]);
+            Op::merge(acc[0], acc[2]);
+            return acc[0];
+        }
+
+        /*
+         * reduceArrayPortable compiled for the selected instruction set
+         */
+        template<typename Op, typename T>
+        typename Op::Acc reduceArray(const T *x, size_t n,
+                                     const typename Op::Acc &init) {
+            typename Op::Acc result = init;
+            MtmCpu::dispatchFor<T>([&] {
+                result = reduceArrayPortable<Op>(x, n, init);
+            });
+            return result;
+        }
+
+        /*
+         * Runs chunk(first, last) over [0, n) and merges the partial
+         * results in chunk order, in parallel once n is big enough
+         */
+        template<typename Op, typename Chunk>
+        typename Op::Acc reduceChunks(size_t n, size_t itemSize,
+                                      const typename Op::Acc &init,
+                                      Chunk chunk) {
+            size_t chunkLength = std::max((size_t) 1,
+                                          REDUCTION_CHUNK / itemSize);
+            if (n * itemSize < REDUCTION_PARALLEL_THRESHOLD) {
+                return chunk(0, n);
+            }
+            size_t chunks = (n + chunkLength - 1) / chunkLength;
+            std::vector<typename Op::Acc> partials(chunks, init);
+            MtmScheduler::parallelFor(
+                    0, chunks, 1, [&](size_t first, size_t last) {
+                        for (size_t c = first; c < last; c++) {
+                            partials[c] = chunk(
+                                    c * chunkLength,
+                                    std::min(n, (c + 1) * chunkLength));
+                        }
+                    });
+            typename Op::Acc result = partials[0];
+            for (size_t c = 1; c < chunks; c++) {
+                Op::merge(result, partials[c]);
+            }
+            return result;
+        }
+
+        template<typename Op, typename T>
+        typename Op::Acc reduceVector(const MtmVec<T> &x,
+                                      const typename Op::Acc &init) {
+            const T *data = x.data();
+            return reduceChunks<Op>(
+                    x.size(), 1, init,
+                    [data, &init](size_t first, size_t last) {
+                        return reduceArray<Op>(data + first, last - first,
+                                               init);
+                    });
+        }
+
+        template<typename Op, typename T>
+        typename Op::Acc reduceMatrix(const MtmMat<T> &a,
+                                      const typename Op::Acc &init) {
+            size_t cols = (size_t) a.getDimensions().getCol();
+            MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+            return reduceChunks<Op>(
+                    (size_t) a.getDimensions().getRow(),
+                    cols, init,
+                    [aRow, cols, &init](size_t first, size_t last) {
+                        typename Op::Acc acc = init;
+                        for (size_t i = first; i < last; i++) {
+                            Op::merge(acc,
+                                      reduceArray<Op>(aRow(i), cols, init));
+                        }
+                        return acc;
+                    });
+        }
+
+        template<typename Op, typename T>
+        T reduceInto(const T *x, size_t n) {
+            return T(Op::finish(reduceArray<Op>(x, n, typename Op::Acc())));
+        }
+
+        /*
+         * Whether T has operator<, MIN and MAX are only defined for those
+         */
+        template<typename T, typename = void>
+        struct IsOrdered : std::false_type {
+        };
+
+        template<typename T>
+        struct IsOrdered<T, decltype((void) (std::declval<const T &>() <
+                                             std::declval<const T &>()))>
+                : std::true_type {
+        };
+
+        template<typename Op, typename T>
+        T reduceOrderedInto(const T *x, size_t n, std::true_type) {
+            return Op::finish(reduceArray<Op>(x, n, x[0]));
+        }
+
+        template<typename Op, typename T>
+        T reduceOrderedInto(const T *, size_t, std::false_type) {
+            //MIN/MAX asked for an element type without an order
+            throw MtmExceptions::IllegalInitialization();
+        }
+
+        /*
+         * Column-wise reduction, out[j] accumulates column j while the rows
+         * are streamed in order
+         */
+        template<typename Op, typename T, typename ARows>
+        void reduceColumns(size_t first, size_t last, size_t rows,
+                           ARows aRow, const typename Op::Acc &init,
+                           bool initFromFirstRow, T *out) {
+            std::vector<typename Op::Acc> acc(last - first, init);
+            if (initFromFirstRow) {
+                for (size_t j = first; j < last; j++) {
+                    acc[j - first] = aRow(0)[j];
+                }
+            }
+            for (size_t i = 0; i < rows; i++) {
+                const T *row = aRow(i);
+                for (size_t j = first; j < last; j++) {
+                    Op::add(acc[j - first], row[j]);
+                }
+            }
+            for (size_t j = first; j < last; j++) {
+                out[j] = T(Op::finish(acc[j - first]));
+            }
+        }
+
+        template<typename Op, typename T, typename ARows>
+        void reduceOrderedColumns(size_t first, size_t last, size_t rows,
+                                  ARows aRow, T *out, std::true_type) {
+            reduceColumns<Op>(first, last, rows, aRow, T(), true, out);
+        }
+
+        template<typename Op, typename T, typename ARows>
+        void reduceOrderedColumns(size_t, size_t, size_t, ARows, T *,
+                                  std::false_type) {
+            //MIN/MAX asked for an element type without an order
+            throw MtmExceptions::IllegalInitialization();
+        }
+
+        template<typename T, typename ARows>
+        void reduceColumns(ReductionType type, size_t first, size_t last,
+                           size_t rows, ARows aRow, T *out) {
+            switch (type) {
+                case SUM:
+                    reduceColumns<Sum<T>>(first, last, rows, aRow, T(),
+                                          false, out);
+                    break;
+                case NORM1:
+                    reduceColumns<Norm1<T>>(first, last, rows, aRow, 0.0,
+                                            false, out);
+                    break;
+                case NORM2:
+                    reduceColumns<Norm2<T>>(first, last, rows, aRow, 0.0,
+                                            false, out);
+                    break;
+                case NORM_INF:
+                    reduceColumns<NormInf<T>>(first, last, rows, aRow, 0.0,
+                                              false, out);
+                    break;
+                case MIN:
+                    reduceOrderedColumns<Min<T>>(first, last, rows, aRow,
+                                                 out, IsOrdered<T>());
+                    break;
+                case MAX:
+                    reduceOrderedColumns<Max<T>>(first, last, rows, aRow,
+                                                 out, IsOrdered<T>());
+                    break;
+            }
+        }
+
+        template<typename T>
+        T reduceRow(ReductionType type, const T *x, size_t n) {
+            switch (type) {
+                case SUM:
+                    return reduceInto<Sum<T>>(x, n);
+                case NORM1:
+                    return reduceInto<Norm1<T>>(x, n);
+                case NORM2:
+                    return reduceInto<Norm2<T>>(x, n);
+                case NORM_INF:
+                    return reduceInto<NormInf<T>>(x, n);
+                case MIN:
+                    return reduceOrderedInto<Min<T>>(x, n, IsOrdered<T>());
+                case MAX:
+                    return reduceOrderedInto<Max<T>>(x, n, IsOrdered<T>());
+            }
+            return T();
+        }
+
+        /*
+         * Position of the best element in [first, last), ties go to the
+         * lower index
+         */
+        template<typename T, typename Better>
+        size_t bestIndex(const T *x, size_t first, size_t last,
+                         Better better) {
+            size_t best = first;
+            for (size_t j = first + 1; j < last; j++) {
+                if (better(x[j], x[best])) {
+                    best = j;
+                }
+            }
+            return best;
+        }
+
+        template<typename T, typename Better>
+        size_t bestIndexParallel(const T *x, size_t n, Better better) {
+            if (n < REDUCTION_PARALLEL_THRESHOLD) {
+                return bestIndex(x, 0, n, better);
+            }
+            size_t chunks = (n + REDUCTION_CHUNK - 1) / REDUCTION_CHUNK;
+            std::vector<size_t> partials(chunks);
+            MtmScheduler::parallelFor(
+                    0, chunks, 1, [&](size_t first, size_t last) {
+                        for (size_t c = first; c < last; c++) {
+                            partials[c] = bestIndex(
+                                    x, c * REDUCTION_CHUNK,
+                                    std::min(n, (c + 1) * REDUCTION_CHUNK),
+                                    better);
+                        }
+                    });
+            size_t best = partials[0];
+            for (size_t c = 1; c < chunks; c++) {
+                if (better(x[partials[c]], x[best])) {
+                    best = partials[c];
+                }
+            }
+            return best;
+        }
+
+        template<typename T>
+        struct Less {
+            bool operator()(const T &a, const T &b) const {
+                return a < b;
+            }
+        };
+
+        template<typename T>
+        struct Greater {
+            bool operator()(const T &a, const T &b) const {
+                return b < a;
+            }
+        };
+
+        template<typename T, typename Better>
+        Dimensions bestLocation(const MtmMat<T> &a, Better better) {
+            size_t rows = (size_t) a.getDimensions().getRow();
+            size_t cols = (size_t) a.getDimensions().getCol();
+            MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+            std::vector<size_t> rowBest(rows);
+            MtmScheduler::placedFor(
+                    0, rows, REDUCTION_PARALLEL_THRESHOLD / cols + 1,
+                    [&](size_t first, size_t last) {
+                        for (size_t i = first; i < last; i++) {
+                            rowBest[i] = bestIndex(aRow(i), 0, cols, better);
+                        }
+                    });
+            size_t best = 0;
+            for (size_t i = 1; i < rows; i++) {
+                if (better(aRow(i)[rowBest[i]], aRow(best)[rowBest[best]])) {
+                    best = i;
+                }
+            }
+            return Dimensions(best, rowBest[best]);
+        }
+    }
+
+    //VECTOR REDUCTIONS
+
+    template<typename T>
+    T sum(const MtmVec<T> &x) {
+        return MtmReductionOps::reduceVector<MtmReductionOps::Sum<T>>(x, T());
+    }
+
+    /*
+     * Inner product of two vectors with the same number of elements,
+     * their orientation does not matter
+     */
+    template<typename T>
+    T dot(const MtmVec<T> &a, const MtmVec<T> &b) {
+        if (a.size() != b.size()) {
+            throw MtmExceptions::DimensionMismatch(a.getDimensions(),
+                                                   b.getDimensions());
+        }
+        const T *x = a.data();
+        const T *y = b.data();
+        return MtmReductionOps::reduceChunks<MtmReductionOps::Sum<T>>(
+                a.size(), 1, T(), [x, y](size_t first, size_t last) {
+                    return MtmKernels::dot(x + first, y + first,
+                                           last - first);
+                });
+    }
+
+    template<typename T>
+    double norm1(const MtmVec<T> &x) {
+        return MtmReductionOps::reduceVector<MtmReductionOps::Norm1<T>>(
+                x, 0.0);
+    }
+
+    template<typename T>
+    double norm2(const MtmVec<T> &x) {
+        return std::sqrt(MtmReductionOps::reduceVector<
+                MtmReductionOps::Norm2<T>>(x, 0.0));
+    }
+
+    template<typename T>
+    double normInf(const MtmVec<T> &x) {
+        return MtmReductionOps::reduceVector<MtmReductionOps::NormInf<T>>(
+                x, 0.0);
+    }
+
+    template<typename T>
+    T minElement(const MtmVec<T> &x) {
+        return MtmReductionOps::reduceVector<MtmReductionOps::Min<T>>(
+                x, x.data()[0]);
+    }
+
+    template<typename T>
+    T maxElement(const MtmVec<T> &x) {
+        return MtmReductionOps::reduceVector<MtmReductionOps::Max<T>>(
+                x, x.data()[0]);
+    }
+
+    template<typename T>
+    size_t argmin(const MtmVec<T> &x) {
+        return MtmReductionOps::bestIndexParallel(
+                x.data(), x.size(), MtmReductionOps::Less<T>());
+    }
+
+    template<typename T>
+    size_t argmax(const MtmVec<T> &x) {
+        return MtmReductionOps::bestIndexParallel(
+                x.data(), x.size(), MtmReductionOps::Greater<T>());
+    }
+
+    //WHOLE MATRIX REDUCTIONS
+
+    template<typename T>
+    T sum(const MtmMat<T> &a) {
+        return MtmReductionOps::reduceMatrix<MtmReductionOps::Sum<T>>(a, T());
+    }
+
+    template<typename T>
+    double frobeniusNorm(const MtmMat<T> &a) {
+        return std::sqrt(MtmReductionOps::reduceMatrix<
+                MtmReductionOps::Norm2<T>>(a, 0.0));
+    }
+
+    template<typename T>
+    T minElement(const MtmMat<T> &a) {
+        return MtmReductionOps::reduceMatrix<MtmReductionOps::Min<T>>(
+                a, a[0][0]);
+    }
+
+    template<typename T>
+    T maxElement(const MtmMat<T> &a) {
+        return MtmReductionOps::reduceMatrix<MtmReductionOps::Max<T>>(
+                a, a[0][0]);
+    }
+
+    /*
+     * Location of the smallest element as (row, col)
+     */
+    template<typename T>
+    Dimensions argmin(const MtmMat<T> &a) {
+        return MtmReductionOps::bestLocation(a, MtmReductionOps::Less<T>());
+    }
+
+    /*
+     * Location of the largest element as (row, col)
+     */
+    template<typename T>
+    Dimensions argmax(const MtmMat<T> &a) {
+        return MtmReductionOps::bestLocation(a,
+                                             MtmReductionOps::Greater<T>());
+    }
+
+    //PER ROW / PER COLUMN REDUCTIONS
+
+    /*
+     * Reduces every row, the result is a column vector with one element
+     * per row. Norms are converted to T.
+     */
+    template<typename T>
+    MtmVec<T> reduceRows(const MtmMat<T> &a, ReductionType type) {
+        size_t rows = (size_t) a.getDimensions().getRow();
+        size_t cols = (size_t) a.getDimensions().getCol();
+        MtmVec<T> result = MtmVec<T>(rows, T());
+        MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+        T *out = result.data();
+        MtmScheduler::placedFor(
+                0, rows, REDUCTION_PARALLEL_THRESHOLD / cols + 1,
+                [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; i++) {
+                        out[i] = MtmReductionOps::reduceRow(type, aRow(i),
+                                                            cols);
+                    }
+                });
+        return result;
+    }
+
+    /*
+     * Reduces every column, the result is a row vector with one element
+     * per column. Norms are converted to T.
+     */
+    template<typename T>
+    MtmVec<T> reduceCols(const MtmMat<T> &a, ReductionType type) {
+        size_t rows = (size_t) a.getDimensions().getRow();
+        size_t cols = (size_t) a.getDimensions().getCol();
+        MtmVec<T> result = MtmVec<T>(cols, T());
+        result.transpose();
+        MtmKernels::MatRows<const MtmMat<T>, const T> aRow(a);
+        T *out = result.data();
+        MtmScheduler::parallelFor(
+                0, cols, REDUCTION_PARALLEL_THRESHOLD / rows + 1,
+                [&](size_t first, size_t last) {
+                    MtmReductionOps::reduceColumns(type, first, last, rows,
+                                                   aRow, out);
+                });
+        return result;
+    }
+
+}
+
+#endif //EX3_MTMREDUCTIONS_H
@@ -0,0 +1,454 @@
+#ifndef EX3_MTMSCHEDULER_H
+#define EX3_MTMSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "MtmStats.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using std::size_t;
+
+namespace MtmMath {
+    namespace MtmScheduler {
+
+        /*
+         * Where the rows of big matrices are placed.
+         * NUMA_OFF - rows are allocated and filled by the calling thread.
+         * NUMA_FIRST_TOUCH - worker w allocates the w-th contiguous block of
+         * rows, so the pages land on its node.
+         * NUMA_INTERLEAVED - row i is allocated by worker i % workers,
+         * spreading the matrix over all nodes.
+         * Row parallel kernels hand out rows with the same pattern (see
+         * placedFor), so every thread works on rows local to it.
+         */
+        enum NumaPolicy {
+            NUMA_OFF,
+            NUMA_FIRST_TOUCH,
+            NUMA_INTERLEAVED
+        };
+
+        //below this many elements a matrix is allocated on the calling thread
+        const size_t NUMA_PLACEMENT_THRESHOLD = 1 << 16;
+
+        /*
+         * Work-stealing task scheduler.
+         * Every worker owns a deque, takes its own work from the back and
+         * steals from the front of the others. Threads that wait on a result
+         * (including workers waiting inside nested parallel code) run queued
+         * tasks instead of blocking, so nesting never adds threads beyond
+         * the fixed pool.
+         */
+        class TaskScheduler {
+            struct Worker {
+                std::mutex lock;
+                std::deque<std::function<void()>> tasks;
+                //tasks only this worker may run, never stolen
+                std::deque<std::function<void()>> pinned;
+                std::atomic<size_t> pinnedCount;
+
+                Worker() : pinnedCount(0) {}
+            };
+
+            std::vector<std::unique_ptr<Worker>> workers;
+            std::vector<std::thread> threads;
+            std::mutex sleepLock;
+            std::condition_variable wake;
+            std::atomic<size_t> queued;
+            std::atomic<size_t> nextQueue;
+            std::atomic<bool> stopping;
+
+            //index of the calling thread in this scheduler, -1 for outsiders
+            static int &currentIndex() {
+                static thread_local int index = -1;
+                return index;
+            }
+
+            static TaskScheduler *&currentScheduler() {
+                static thread_local TaskScheduler *scheduler = nullptr;
+                return scheduler;
+            }
+
+            int ownIndex() const {
+                return currentScheduler() == this ? currentIndex() : -1;
+            }
+
+            bool popPinned(int index, std::function<void()> &task) {
+                Worker &worker = *workers[index];
+                if (worker.pinnedCount == 0) {
+                    return false;
+                }
+                std::lock_guard<std::mutex> guard(worker.lock);
+                task = std::move(worker.pinned.front());
+                worker.pinned.pop_front();
+                worker.pinnedCount.fetch_sub(1);
+                return true;
+            }
+
+            bool popOwn(int index, std::function<void()> &task) {
+                Worker &worker = *workers[index];
+                std::lock_guard<std::mutex> guard(worker.lock);
+                if (worker.tasks.empty()) {
+                    return false;
+                }
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+                return true;
+            }
+
+            bool steal(int thief, std::function<void()> &task) {
+                size_t count = workers.size();
+                size_t start = thief < 0 ? nextQueue.load() : (size_t) thief;
+                for (size_t k = 1; k <= count; k++) {
+                    Worker &victim = *workers[(start + k) % count];
+                    std::lock_guard<std::mutex> guard(victim.lock);
+                    if (!victim.tasks.empty()) {
+                        task = std::move(victim.tasks.front());
+                        victim.tasks.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void workerLoop(int index) {
+                currentIndex() = index;
+                currentScheduler() = this;
+                while (!stopping) {
+                    if (runOne()) {
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> guard(sleepLock);
+                    wake.wait(guard, [this, index] {
+                        return stopping || queued > 0 ||
+                               workers[index]->pinnedCount > 0;
+                    });
+                }
+            }
+
+        public:
+
+            explicit TaskScheduler(size_t threadCount =
+            std::max(1u, std::thread::hardware_concurrency()))
+                    : queued(0), nextQueue(0), stopping(false) {
+                threadCount = std::max((size_t) 1, threadCount);
+                for (size_t i = 0; i < threadCount; i++) {
+                    workers.emplace_back(new Worker());
+                }
+                for (size_t i = 0; i < threadCount; i++) {
+                    threads.emplace_back(&TaskScheduler::workerLoop, this,
+                                         (int) i);
+                }
+            }
+
+            TaskScheduler(const TaskScheduler &) = delete;
+
+            TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+            ~TaskScheduler() {
+                {
+                    std::lock_guard<std::mutex> guard(sleepLock);
+                    stopping = true;
+                }
+                wake.notify_all();
+                for (size_t i = 0; i < threads.size(); i++) {
+                    threads[i].join();
+                }
+            }
+
+            size_t workerCount() const {
+                return workers.size();
+            }
+
+            /*
+             * Whether the calling thread is one of this scheduler's workers
+             */
+            bool isWorkerThread() const {
+                return ownIndex() >= 0;
+            }
+
+            /*
+             * Queues a task. Workers push onto their own deque so nested work
+             * stays local, outside threads spread tasks round-robin.
+             */
+            void submit(std::function<void()> task) {
+                int index = ownIndex();
+                size_t target = index >= 0 ? (size_t) index :
+                                nextQueue.fetch_add(1) % workers.size();
+                {
+                    std::lock_guard<std::mutex> guard(workers[target]->lock);
+                    workers[target]->tasks.push_back(std::move(task));
+                }
+                queued.fetch_add(1);
+                {
+                    std::lock_guard<std::mutex> guard(sleepLock);
+                }
+                wake.notify_one();
+            }
+
+            /*
+             * Queues a task that only worker number index will run
+             */
+            void submitTo(size_t index, std::function<void()> task) {
+                Worker &worker = *workers[index % workers.size()];
+                {
+                    std::lock_guard<std::mutex> guard(worker.lock);
+                    worker.pinned.push_back(std::move(task));
+                    worker.pinnedCount.fetch_add(1);
+                }
+                {
+                    std::lock_guard<std::mutex> guard(sleepLock);
+                }
+                wake.notify_all();
+            }
+
+            /*
+             * Runs one queued task on the calling thread if there is any,
+             * returns whether a task ran
+             */
+            bool runOne() {
+                MTM_STATS_TASK();
+                std::function<void()> task;
+                int index = ownIndex();
+                if (index >= 0 && popPinned(index, task)) {
+                    task();
+                    return true;
+                }
+                if (!(index >= 0 && popOwn(index, task)) &&
+                    !steal(index, task)) {
+                    return false;
+                }
+                queued.fetch_sub(1);
+                task();
+                return true;
+            }
+
+            /*
+             * Keeps the calling thread busy with queued tasks until done()
+             * returns true, this is how every wait in the library is done
+             */
+            template<typename Predicate>
+            void helpUntil(Predicate done) {
+                while (!done()) {
+                    if (!runOne()) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+
+            /*
+             * Calls body(first, last) on disjoint chunks that cover
+             * [begin, end), chunks are at least grain long. The calling
+             * thread takes part and returns when every chunk finished.
+             */
+            template<typename Body>
+            void parallelFor(size_t begin, size_t end, size_t grain,
+                             Body body) {
+                if (end <= begin) {
+                    return;
+                }
+                grain = std::max((size_t) 1, grain);
+                size_t length = end - begin;
+                size_t chunks = std::min(workers.size() * 4,
+                                         (length + grain - 1) / grain);
+                if (chunks <= 1) {
+                    body(begin, end);
+                    return;
+                }
+
+                size_t chunkLength = (length + chunks - 1) / chunks;
+                std::atomic<size_t> remaining(chunks - 1);
+                std::exception_ptr error;
+                std::mutex errorLock;
+                for (size_t c = 1; c < chunks; c++) {
+                    size_t first = begin + c * chunkLength;
+                    size_t last = std::min(end, first + chunkLength);
+                    submit([&, first, last] {
+                        try {
+                            if (first < last) {
+                                body(first, last);
+                            }
+                        }
+                        catch (...) {
+                            std::lock_guard<std::mutex> guard(errorLock);
+                            error = std::current_exception();
+                        }
+                        remaining.fetch_sub(1);
+                    });
+                }
+
+                try {
+                    body(begin, std::min(end, begin + chunkLength));
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> guard(errorLock);
+                    error = std::current_exception();
+                }
+                helpUntil([&remaining] { return remaining.load() == 0; });
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            /*
+             * Calls body(first, last) over [begin, end) with a fixed
+             * assignment of indices to workers: contiguous blocks for
+             * NUMA_FIRST_TOUCH, index i to worker i % workers for
+             * NUMA_INTERLEAVED. The same range always maps to the same
+             * workers, so data a worker touched first is local to it later.
+             */
+            template<typename Body>
+            void parallelForPlaced(size_t begin, size_t end,
+                                   NumaPolicy policy, Body body) {
+                if (end <= begin) {
+                    return;
+                }
+                size_t count = workers.size();
+                size_t length = end - begin;
+                std::atomic<size_t> remaining(count);
+                std::exception_ptr error;
+                std::mutex errorLock;
+                for (size_t w = 0; w < count; w++) {
+                    submitTo(w, [&, w] {
+                        try {
+                            if (policy == NUMA_INTERLEAVED) {
+                                for (size_t i = begin + w; i < end;
+                                     i += count) {
+                                    body(i, i + 1);
+                                }
+                            } else {
+                                size_t first = begin + length * w / count;
+                                size_t last = begin + length * (w + 1) / count;
+                                if (first < last) {
+                                    body(first, last);
+                                }
+                            }
+                        }
+                        catch (...) {
+                            std::lock_guard<std::mutex> guard(errorLock);
+                            error = std::current_exception();
+                        }
+                        remaining.fetch_sub(1);
+                    });
+                }
+                helpUntil([&remaining] { return remaining.load() == 0; });
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            /*
+             * Binds worker w to the w-th cpu the process may run on (its
+             * affinity mask, which includes the cgroup cpuset) so
+             * first-touch placement stays meaningful. Returns true when
+             * every worker is bound; a worker that can not be bound keeps
+             * running unpinned. Only done on Linux.
+             */
+            bool pinWorkers() {
+#ifdef __linux__
+                cpu_set_t allowed;
+                CPU_ZERO(&allowed);
+                if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+                    return false;
+                }
+                std::vector<int> cpus;
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (CPU_ISSET(cpu, &allowed)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                if (cpus.empty()) {
+                    return false;
+                }
+                std::atomic<size_t> remaining(workers.size());
+                std::atomic<size_t> failed(0);
+                for (size_t w = 0; w < workers.size(); w++) {
+                    int cpu = cpus[w % cpus.size()];
+                    submitTo(w, [&remaining, &failed, cpu] {
+                        cpu_set_t set;
+                        CPU_ZERO(&set);
+                        CPU_SET(cpu, &set);
+                        if (pthread_setaffinity_np(pthread_self(),
+                                                   sizeof(set), &set) != 0) {
+                            failed.fetch_add(1);
+                        }
+                        remaining.fetch_sub(1);
+                    });
+                }
+                helpUntil([&remaining] { return remaining.load() == 0; });
+                return failed.load() == 0;
+#else
+                return false;
+#endif
+            }
+        };
+
+        /*
+         * Process wide scheduler used by the parallel and async parts of the
+         * library, one worker per hardware thread
+         */
+        inline TaskScheduler &defaultScheduler() {
+            static TaskScheduler scheduler;
+            return scheduler;
+        }
+
+        /*
+         * Shorthand for defaultScheduler().parallelFor
+         */
+        template<typename Body>
+        void parallelFor(size_t begin, size_t end, size_t grain, Body body) {
+            defaultScheduler().parallelFor(begin, end, grain, body);
+        }
+
+        inline std::atomic<int> &numaPolicyStorage() {
+            static std::atomic<int> policy(NUMA_OFF);
+            return policy;
+        }
+
+        inline NumaPolicy numaPolicy() {
+            return (NumaPolicy) numaPolicyStorage().load();
+        }
+
+        /*
+         * Sets the process wide placement policy, turning it on pins the
+         * default scheduler's workers to the cpus the process may use
+         */
+        inline void setNumaPolicy(NumaPolicy policy) {
+            static std::once_flag pinned;
+            if (policy != NUMA_OFF) {
+                std::call_once(pinned, [] {
+                    defaultScheduler().pinWorkers();
+                });
+            }
+            numaPolicyStorage() = policy;
+        }
+
+        /*
+         * parallelFor over matrix rows that follows the NUMA policy, so
+         * rows are processed by the worker that placed them. Ranges of
+         * up to grain rows run on the calling thread.
+         */
+        template<typename Body>
+        void placedFor(size_t begin, size_t end, size_t grain, Body body) {
+            NumaPolicy policy = numaPolicy();
+            if (policy == NUMA_OFF || end <= begin || end - begin <= grain) {
+                parallelFor(begin, end, grain, body);
+                return;
+            }
+            defaultScheduler().parallelForPlaced(begin, end, policy, body);
+        }
+    }
+}
+
+#endif //EX3_MTMSCHEDULER_H
@@ -0,0 +1,92 @@
+#ifndef EX3_MTMSHARED_H
+#define EX3_MTMSHARED_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+
+namespace MtmMath {
+
+    /*
+     * Copy-on-write handle to a vector or matrix (any copyable M).
+     * Copies share one instance through an atomic reference count, so
+     * copying, snapshotting and passing a handle to other threads is O(1).
+     * The first write() through a handle that is not the only owner makes
+     * a private deep copy first, the other handles keep seeing the old
+     * values.
+     * Handles that share storage can be used from different threads, one
+     * handle object must not be written and copied at the same time.
+     */
+    template<typename M>
+    class MtmShared {
+        std::shared_ptr<M> value;
+
+    public:
+
+        explicit MtmShared(const M &value_t) try
+                : value(std::make_shared<M>(value_t)) {}
+        catch (std::bad_alloc &e) {
+            throw MtmExceptions::OutOfMemory();
+        }
+
+        explicit MtmShared(M &&value_t) try
+                : value(std::make_shared<M>(std::move(value_t))) {}
+        catch (std::bad_alloc &e) {
+            throw MtmExceptions::OutOfMemory();
+        }
+
+        MtmShared(const MtmShared &toCopy) = default;
+
+        MtmShared &operator=(const MtmShared &c) = default;
+
+        ~MtmShared() = default;
+
+        const M &read() const {
+            return *value;
+        }
+
+        const M &operator*() const {
+            return *value;
+        }
+
+        const M *operator->() const {
+            return value.get();
+        }
+
+        /*
+         * Writable access, copies the shared instance first if any other
+         * handle still refers to it. The reference is valid until this
+         * handle is copied or assigned to.
+         */
+        M &write() {
+            if (value.use_count() != 1) {
+                value = std::make_shared<M>(*value);
+            }
+            //pairs with the release of the last other owner
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return *value;
+        }
+
+        /*
+         * O(1) copy that keeps the current values no matter what is
+         * written through this handle later
+         */
+        MtmShared snapshot() const {
+            return *this;
+        }
+
+        bool isShared() const {
+            return value.use_count() > 1;
+        }
+    };
+
+    template<typename M>
+    MtmShared<typename std::decay<M>::type> makeShared(M &&value) {
+        return MtmShared<typename std::decay<M>::type>(std::forward<M>(value));
+    }
+
+}
+
+#endif //EX3_MTMSHARED_H
@@ -0,0 +1,364 @@
+#ifndef EX3_MTMSMALLVEC_H
+#define EX3_MTMSMALLVEC_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+using std::size_t;
+
+/*
+ * Element storage of MtmVec: a std::vector-like array that keeps up to
+ * N elements inside the object and only goes to the heap above that, so
+ * short vectors (the 2 - 16 element temporaries of hot loops) never touch
+ * the allocator. data() always points at the elements, inline or not.
+ * Moving or swapping heap storage takes over the block in O(1), inline
+ * elements are moved one by one (at most N of them). Pointers into the
+ * storage are invalidated by a move or swap of inline storage, as they are
+ * by a reallocation.
+ */
+
+namespace MtmMath {
+
+    //elements a short MtmVec keeps inline
+    const size_t VEC_INLINE_CAPACITY = 16;
+
+    //largest element kept inline (Complex fits)
+    const size_t VEC_INLINE_ELEMENT_SIZE = 16;
+
+    namespace MtmSmallVecOps {
+
+        /*
+         * Inline capacity for elements of type T: only small elements
+         * that are copied and destroyed trivially (numbers, Complex)
+         * are kept inline; rows of a matrix (MtmVec<MtmVec<T>>) stay on
+         * the heap so exchanging them is O(1).
+         */
+        template<typename T>
+        constexpr size_t inlineCapacity() {
+            return (std::is_trivially_copy_constructible<T>::value &&
+                    std::is_trivially_destructible<T>::value &&
+                    sizeof(T) <= VEC_INLINE_ELEMENT_SIZE) ?
+                   VEC_INLINE_CAPACITY : 0;
+        }
+
+        template<typename T, size_t N>
+        struct InlineBuffer {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type
+                    slots[N];
+
+            T *get() {
+                return reinterpret_cast<T *>(slots);
+            }
+        };
+
+        template<typename T>
+        struct InlineBuffer<T, 0> {
+            T *get() {
+                return nullptr;
+            }
+        };
+    }
+
+    template<typename T, size_t N>
+    class MtmSmallVec : private MtmSmallVecOps::InlineBuffer<T, N> {
+        T *elements;
+        size_t count;
+        size_t allocated;
+
+        T *inlineData() {
+            return MtmSmallVecOps::InlineBuffer<T, N>::get();
+        }
+
+        bool isInline() const {
+            return N > 0 && allocated == N;
+        }
+
+        static T *allocate(size_t n) {
+            return std::allocator<T>().allocate(n);
+        }
+
+        void release() {
+            if (!isInline() && elements != nullptr) {
+                std::allocator<T>().deallocate(elements, allocated);
+            }
+        }
+
+        void destroy(size_t from, size_t to) {
+            for (size_t i = from; i < to; i++) {
+                elements[i].~T();
+            }
+        }
+
+        void resetToEmpty() {
+            elements = inlineData();
+            count = 0;
+            allocated = N;
+        }
+
+        /*
+         * Moves the elements into storage for exactly capacity elements,
+         * inline when they fit and the storage is not inline already
+         */
+        void relocate(size_t capacity) {
+            T *target = capacity <= N ? inlineData() : allocate(capacity);
+            for (size_t i = 0; i < count; i++) {
+                new(target + i) T(std::move_if_noexcept(elements[i]));
+                elements[i].~T();
+            }
+            release();
+            elements = target;
+            allocated = capacity <= N ? N : capacity;
+        }
+
+        void grow(size_t needed) {
+            if (needed > allocated) {
+                relocate(std::max(needed, 2 * allocated));
+            }
+        }
+
+        //takes the elements of other, leaving it empty
+        void takeFrom(MtmSmallVec &other) {
+            if (!other.isInline()) {
+                elements = other.elements;
+                count = other.count;
+                allocated = other.allocated;
+                other.resetToEmpty();
+                return;
+            }
+            resetToEmpty();
+            for (size_t i = 0; i < other.count; i++) {
+                new(elements + i) T(std::move(other.elements[i]));
+            }
+            count = other.count;
+            other.clear();
+        }
+
+    public:
+        typedef T value_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        MtmSmallVec() {
+            resetToEmpty();
+        }
+
+        MtmSmallVec(size_t n, const T &val) {
+            resetToEmpty();
+            assign(n, val);
+        }
+
+        MtmSmallVec(const MtmSmallVec &toCopy) : MtmSmallVec() {
+            reserve(toCopy.count);
+            std::uninitialized_copy(toCopy.elements,
+                                    toCopy.elements + toCopy.count, elements);
+            count = toCopy.count;
+        }
+
+        MtmSmallVec(MtmSmallVec &&toMove) noexcept {
+            takeFrom(toMove);
+        }
+
+        ~MtmSmallVec() {
+            clear();
+            release();
+        }
+
+        MtmSmallVec &operator=(const MtmSmallVec &c) {
+            if (this == &c) {
+                return *this;
+            }
+            clear();
+            reserve(c.count);
+            std::uninitialized_copy(c.elements, c.elements + c.count,
+                                    elements);
+            count = c.count;
+            return *this;
+        }
+
+        MtmSmallVec &operator=(MtmSmallVec &&c) noexcept {
+            if (this == &c) {
+                return *this;
+            }
+            clear();
+            release();
+            takeFrom(c);
+            return *this;
+        }
+
+        T *data() {
+            return elements;
+        }
+
+        const T *data() const {
+            return elements;
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        size_t capacity() const {
+            return allocated;
+        }
+
+        T &operator[](size_t index) {
+            return elements[index];
+        }
+
+        const T &operator[](size_t index) const {
+            return elements[index];
+        }
+
+        T &at(size_t index) {
+            if (index >= count) {
+                throw std::out_of_range("MtmSmallVec::at");
+            }
+            return elements[index];
+        }
+
+        const T &at(size_t index) const {
+            if (index >= count) {
+                throw std::out_of_range("MtmSmallVec::at");
+            }
+            return elements[index];
+        }
+
+        T &front() {
+            return elements[0];
+        }
+
+        const T &front() const {
+            return elements[0];
+        }
+
+        T &back() {
+            return elements[count - 1];
+        }
+
+        const T &back() const {
+            return elements[count - 1];
+        }
+
+        void reserve(size_t capacity) {
+            if (capacity > allocated) {
+                relocate(capacity);
+            }
+        }
+
+        /*
+         * Moves the elements back inline when they fit, otherwise to a
+         * block of exactly size() elements
+         */
+        void shrink_to_fit() {
+            if (count < allocated && !isInline()) {
+                relocate(count);
+            }
+        }
+
+        void clear() {
+            destroy(0, count);
+            count = 0;
+        }
+
+        void resize(size_t n) {
+            resize(n, T());
+        }
+
+        void resize(size_t n, const T &val) {
+            if (n <= count) {
+                destroy(n, count);
+                count = n;
+                return;
+            }
+            if (n > allocated) {
+                //val may be one of the elements
+                T copy(val);
+                relocate(std::max(n, 2 * allocated));
+                std::uninitialized_fill(elements + count, elements + n, copy);
+            } else {
+                std::uninitialized_fill(elements + count, elements + n, val);
+            }
+            count = n;
+        }
+
+        void assign(size_t n, const T &val) {
+            T copy(val);
+            clear();
+            reserve(n);
+            std::uninitialized_fill(elements, elements + n, copy);
+            count = n;
+        }
+
+        void push_back(const T &val) {
+            if (count == allocated) {
+                T copy(val);
+                grow(count + 1);
+                new(elements + count) T(std::move(copy));
+            } else {
+                new(elements + count) T(val);
+            }
+            count++;
+        }
+
+        void push_back(T &&val) {
+            if (count == allocated) {
+                T moved(std::move(val));
+                grow(count + 1);
+                new(elements + count) T(std::move(moved));
+            } else {
+                new(elements + count) T(std::move(val));
+            }
+            count++;
+        }
+
+        template<typename... Args>
+        T &emplace_back(Args &&... args) {
+            if (count == allocated) {
+                T made(std::forward<Args>(args)...);
+                grow(count + 1);
+                new(elements + count) T(std::move(made));
+            } else {
+                new(elements + count) T(std::forward<Args>(args)...);
+            }
+            return elements[count++];
+        }
+
+        void pop_back() {
+            elements[--count].~T();
+        }
+
+        /*
+         * Exchanges the contents, O(1) when neither side is inline
+         */
+        void swap(MtmSmallVec &other) noexcept {
+            if (this == &other) {
+                return;
+            }
+            if (!isInline() && !other.isInline()) {
+                std::swap(elements, other.elements);
+                std::swap(count, other.count);
+                std::swap(allocated, other.allocated);
+                return;
+            }
+            MtmSmallVec temporary(std::move(other));
+            other = std::move(*this);
+            *this = std::move(temporary);
+        }
+    };
+
+}
+
+#endif //EX3_MTMSMALLVEC_H
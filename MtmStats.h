@@ -0,0 +1,336 @@
+#ifndef EX3_MTMSTATS_H
+#define EX3_MTMSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/*
+ * Opt-in instrumentation for MtmVec/MtmMat operations.
+ * Compile with MTM_STATS defined to turn the counters on. Without it every
+ * MTM_STATS_* macro expands to nothing, so the library pays no cost.
+ */
+
+namespace MtmMath {
+    namespace MtmStats {
+
+        enum Operation {
+            VEC_ADD,
+            VEC_SCALAR_ADD,
+            VEC_SCALE,
+            VEC_NEGATE,
+            VEC_DOT,
+            VEC_ALLOW_ALL,
+            MAT_ADD,
+            MAT_SCALAR_ADD,
+            MAT_SCALE,
+            MAT_MULTIPLY,
+            MAT_MULTIPLY_3M,
+            MAT_VEC_MULTIPLY,
+            VEC_MAT_MULTIPLY,
+            MAT_GET_COL_VECTOR,
+            MAT_TRANSPOSE,
+            MAT_RESIZE,
+            MAT_RESHAPE,
+            BAND_MULTIPLY,
+            BAND_SOLVE,
+            BLAS_AXPY,
+            BLAS_SCAL,
+            BLAS_GEMV,
+            BLAS_GEMM,
+            ELEMENTWISE_MAP,
+            SPARSE_MULTIPLY,
+            TRIANGULAR_MULTIPLY,
+            QUANTIZED_MULTIPLY,
+            BLAS_GER,
+            BLAS_SYRK,
+            KRONECKER_MULTIPLY,
+            FFT_TRANSFORM,
+            OPERATION_COUNT
+        };
+
+        inline const char *operationName(Operation op) {
+            static const char *names[OPERATION_COUNT] = {
+                    "vec +=", "vec += scalar", "vec *= scalar", "vec negate",
+                    "vec dot", "vec allowAllVec", "mat +=",
+                    "mat + scalar", "mat * scalar", "mat * mat",
+                    "mat * mat (3M)", "mat * vec", "vec * mat",
+                    "mat getColVector", "mat transpose",
+                    "mat resize", "mat reshape", "band * vec", "band solve",
+                    "axpy", "scal", "gemv", "gemm", "element-wise map",
+                    "sparse * vec", "triangular * mat", "quantized mat * mat",
+                    "ger", "syrk", "kronecker * vec", "fft"
+            };
+            return names[op];
+        }
+
+        struct OperationStats {
+            unsigned long long calls;
+            unsigned long long flops;
+            unsigned long long nanoseconds;
+        };
+
+        /*
+         * Plain copy of all counters at one point in time. Subtracting two
+         * snapshots gives the cost of everything that ran in between
+         * (peakLiveBytes is kept from the later snapshot).
+         */
+        struct Snapshot {
+            OperationStats operations[OPERATION_COUNT];
+            unsigned long long bytesAllocated;
+            unsigned long long bytesCopied;
+            unsigned long long liveBytes;
+            unsigned long long peakLiveBytes;
+
+            Snapshot operator-(const Snapshot &earlier) const {
+                Snapshot result = *this;
+                for (int i = 0; i < OPERATION_COUNT; i++) {
+                    result.operations[i].calls -= earlier.operations[i].calls;
+                    result.operations[i].flops -= earlier.operations[i].flops;
+                    result.operations[i].nanoseconds -=
+                            earlier.operations[i].nanoseconds;
+                }
+                result.bytesAllocated -= earlier.bytesAllocated;
+                result.bytesCopied -= earlier.bytesCopied;
+                return result;
+            }
+
+            std::string to_string() const {
+                std::string out;
+                for (int i = 0; i < OPERATION_COUNT; i++) {
+                    if (operations[i].calls == 0) {
+                        continue;
+                    }
+                    out += std::string(operationName((Operation) i)) +
+                           ": calls=" + std::to_string(operations[i].calls) +
+                           " flops=" + std::to_string(operations[i].flops) +
+                           " ns=" + std::to_string(operations[i].nanoseconds) +
+                           "\n";
+                }
+                out += "allocated=" + std::to_string(bytesAllocated) +
+                       " copied=" + std::to_string(bytesCopied) +
+                       " live=" + std::to_string(liveBytes) +
+                       " peak=" + std::to_string(peakLiveBytes) + "\n";
+                return out;
+            }
+        };
+
+        //COUNTER STORAGE
+
+        class Registry {
+            struct AtomicOperation {
+                std::atomic<unsigned long long> calls;
+                std::atomic<unsigned long long> flops;
+                std::atomic<unsigned long long> nanoseconds;
+            };
+
+            AtomicOperation operations[OPERATION_COUNT];
+            std::atomic<unsigned long long> bytesAllocated;
+            std::atomic<unsigned long long> bytesCopied;
+            std::atomic<long long> liveBytes;
+            std::atomic<long long> peakLiveBytes;
+
+        public:
+            Registry() {
+                liveBytes = 0;
+                reset();
+            }
+
+            void reset() {
+                for (int i = 0; i < OPERATION_COUNT; i++) {
+                    operations[i].calls = 0;
+                    operations[i].flops = 0;
+                    operations[i].nanoseconds = 0;
+                }
+                bytesAllocated = 0;
+                bytesCopied = 0;
+                //live memory is a property of the objects, not of the
+                //measured interval, so only the peak restarts from it
+                peakLiveBytes = liveBytes.load();
+            }
+
+            void addCall(Operation op, unsigned long long flops) {
+                operations[op].calls.fetch_add(1, std::memory_order_relaxed);
+                operations[op].flops.fetch_add(flops,
+                                               std::memory_order_relaxed);
+            }
+
+            void addTime(Operation op, unsigned long long ns) {
+                operations[op].nanoseconds.fetch_add(
+                        ns, std::memory_order_relaxed);
+            }
+
+            void addAllocation(unsigned long long bytes) {
+                bytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+                long long live = liveBytes.fetch_add(
+                        (long long) bytes, std::memory_order_relaxed) +
+                                 (long long) bytes;
+                long long peak = peakLiveBytes.load(std::memory_order_relaxed);
+                while (live > peak &&
+                       !peakLiveBytes.compare_exchange_weak(
+                               peak, live, std::memory_order_relaxed)) {}
+            }
+
+            void addRelease(unsigned long long bytes) {
+                liveBytes.fetch_sub((long long) bytes,
+                                    std::memory_order_relaxed);
+            }
+
+            void addCopy(unsigned long long bytes) {
+                bytesCopied.fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            Snapshot snapshot() const {
+                Snapshot result;
+                for (int i = 0; i < OPERATION_COUNT; i++) {
+                    result.operations[i].calls = operations[i].calls.load();
+                    result.operations[i].flops = operations[i].flops.load();
+                    result.operations[i].nanoseconds =
+                            operations[i].nanoseconds.load();
+                }
+                result.bytesAllocated = bytesAllocated.load();
+                result.bytesCopied = bytesCopied.load();
+                long long live = liveBytes.load();
+                long long peak = peakLiveBytes.load();
+                result.liveBytes = live > 0 ? (unsigned long long) live : 0;
+                result.peakLiveBytes = peak > 0 ? (unsigned long long) peak : 0;
+                return result;
+            }
+        };
+
+        inline Registry &registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        //PUBLIC API
+
+        inline Snapshot snapshot() {
+            return registry().snapshot();
+        }
+
+        inline void reset() {
+            registry().reset();
+        }
+
+        /*
+         * Operations running on this thread. Only the outermost one is
+         * counted: the row operations a matrix operation is made of are
+         * part of its flops and time, not calls of their own.
+         */
+        inline int &nesting() {
+            static thread_local int depth = 0;
+            return depth;
+        }
+
+        /*
+         * Counts one call of op with the given flop count and adds the wall
+         * time until the end of the enclosing scope, unless it runs inside
+         * another operation.
+         */
+        class ScopedOperation {
+            Operation op;
+            bool counted;
+            std::chrono::steady_clock::time_point start;
+        public:
+            ScopedOperation(Operation op_t, unsigned long long flops)
+                    : op(op_t), counted(nesting()++ == 0) {
+                if (counted) {
+                    registry().addCall(op, flops);
+                    start = std::chrono::steady_clock::now();
+                }
+            }
+
+            ScopedOperation(const ScopedOperation &) = delete;
+
+            ScopedOperation &operator=(const ScopedOperation &) = delete;
+
+            ~ScopedOperation() {
+                nesting()--;
+                if (!counted) {
+                    return;
+                }
+                registry().addTime(op, (unsigned long long)
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() -
+                                start).count());
+            }
+        };
+
+        /*
+         * A scheduler task starts outside of any operation, even when the
+         * thread running it waits inside one
+         */
+        class ScopedTask {
+            int saved;
+        public:
+            ScopedTask() : saved(nesting()) {
+                nesting() = 0;
+            }
+
+            ScopedTask(const ScopedTask &) = delete;
+
+            ScopedTask &operator=(const ScopedTask &) = delete;
+
+            ~ScopedTask() {
+                nesting() = saved;
+            }
+        };
+
+        /*
+         * Tracks a named region of user code. delta() returns what the
+         * library did since the region started and seconds() its wall time.
+         * Works whether or not MTM_STATS is defined, but counters only move
+         * when it is.
+         */
+        class ScopedRegion {
+            std::string regionName;
+            Snapshot begin;
+            std::chrono::steady_clock::time_point start;
+        public:
+            explicit ScopedRegion(const std::string &name_t)
+                    : regionName(name_t), begin(snapshot()),
+                      start(std::chrono::steady_clock::now()) {}
+
+            const std::string &name() const {
+                return regionName;
+            }
+
+            Snapshot delta() const {
+                return snapshot() - begin;
+            }
+
+            double seconds() const {
+                return std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+            }
+        };
+    }
+}
+
+#ifdef MTM_STATS
+
+#define MTM_STATS_OPERATION(op, flops) \
+    MtmMath::MtmStats::ScopedOperation mtmStatsOperation( \
+            MtmMath::MtmStats::op, (unsigned long long) (flops))
+#define MTM_STATS_ALLOCATE(bytes) \
+    MtmMath::MtmStats::registry().addAllocation( \
+            (unsigned long long) (bytes))
+#define MTM_STATS_RELEASE(bytes) \
+    MtmMath::MtmStats::registry().addRelease((unsigned long long) (bytes))
+#define MTM_STATS_COPY(bytes) \
+    MtmMath::MtmStats::registry().addCopy((unsigned long long) (bytes))
+#define MTM_STATS_TASK() \
+    MtmMath::MtmStats::ScopedTask mtmStatsTask
+
+#else
+
+#define MTM_STATS_OPERATION(op, flops) ((void) 0)
+#define MTM_STATS_ALLOCATE(bytes) ((void) 0)
+#define MTM_STATS_RELEASE(bytes) ((void) 0)
+#define MTM_STATS_COPY(bytes) ((void) 0)
+#define MTM_STATS_TASK() ((void) 0)
+
+#endif
+
+#endif //EX3_MTMSTATS_H
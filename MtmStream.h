@@ -0,0 +1,452 @@
+#ifndef EX3_MTMSTREAM_H
+#define EX3_MTMSTREAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+#include "MtmExceptions.h"
+#include "Auxilaries.h"
+#include "Complex.h"
+#include "MtmKernels.h"
+#include "MtmMat.h"
+
+using std::size_t;
+
+/*
+ * Streaming binary format for moving vectors and matrices through pipes and
+ * sockets.
+ * A stream is a header (magic, kind, element size, dimensions, chunk size)
+ * followed by chunks of at most chunkElements elements in row major order.
+ * Every chunk is stored raw, or with zero-run encoding when that comes out
+ * smaller. Raw chunks go straight between the stream and the row storage
+ * without an intermediate buffer.
+ * The reader fills the result chunk by chunk and reports every block of
+ * rows as soon as it is complete, so work on the first rows can start
+ * while the rest is still arriving.
+ * Elements are written in the native byte order and T has to be trivially
+ * copyable (or Complex), so both ends must run on the same kind of machine.
+ */
+
+namespace MtmMath {
+    namespace MtmStream {
+
+        const size_t DEFAULT_CHUNK_ELEMENTS = 1 << 15;
+
+        enum Encoding {
+            RAW = 0,
+            ZERO_RUN = 1
+        };
+
+        namespace MtmStreamOps {
+
+            const char MAGIC[4] = {'M', 'T', 'M', 'S'};
+            const uint8_t VERSION = 1;
+            const uint8_t KIND_VECTOR = 0;
+            const uint8_t KIND_MATRIX = 1;
+
+            struct Header {
+                uint8_t kind;
+                uint32_t elementSize;
+                uint64_t rows;
+                uint64_t cols;
+                uint32_t chunkElements;
+            };
+
+            template<typename U>
+            void put(std::ostream &os, U value) {
+                os.write((const char *) &value, sizeof(U));
+            }
+
+            template<typename U>
+            U get(std::istream &is) {
+                U value;
+                if (!is.read((char *) &value, sizeof(U))) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                return value;
+            }
+
+            inline void writeHeader(std::ostream &os, const Header &header) {
+                os.write(MAGIC, sizeof(MAGIC));
+                put<uint8_t>(os, VERSION);
+                put<uint8_t>(os, header.kind);
+                put<uint32_t>(os, header.elementSize);
+                put<uint64_t>(os, header.rows);
+                put<uint64_t>(os, header.cols);
+                put<uint32_t>(os, header.chunkElements);
+            }
+
+            inline Header readHeader(std::istream &is, uint8_t kind,
+                                     size_t elementSize) {
+                char magic[sizeof(MAGIC)];
+                if (!is.read(magic, sizeof(MAGIC)) ||
+                    memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+                    get<uint8_t>(is) != VERSION) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                Header header;
+                header.kind = get<uint8_t>(is);
+                header.elementSize = get<uint32_t>(is);
+                header.rows = get<uint64_t>(is);
+                header.cols = get<uint64_t>(is);
+                header.chunkElements = get<uint32_t>(is);
+                if (header.kind != kind || header.elementSize != elementSize ||
+                    header.rows == 0 || header.cols == 0 ||
+                    header.chunkElements == 0 ||
+                    header.rows > SIZE_MAX / header.cols) {
+                    throw MtmExceptions::MalformedStream();
+                }
+                return header;
+            }
+
+            /*
+             * Calls f(pointer, n) for every row piece of the count elements
+             * that start at row major position first
+             */
+            template<typename Rows, typename F>
+            void forEachSegment(Rows row, size_t cols, size_t first,
+                                size_t count, F f) {
+                size_t i = first / cols;
+                size_t j = first % cols;
+                while (count > 0) {
+                    size_t n = std::min(count, cols - j);
+                    f(row(i) + j, n);
+                    count -= n;
+                    j = 0;
+                    i++;
+                }
+            }
+
+            /*
+             * T() is all zero bytes for the numeric types, comparing bytes
+             * keeps -0.0 and friends intact through the encoding
+             */
+            template<typename T>
+            bool isZero(const T &x) {
+                static const T zero = T();
+                return memcmp(&x, &zero, sizeof(T)) == 0;
+            }
+
+            /*
+             * Zero-run payload: records of (zero count, literal count)
+             * followed by the literal elements. Gives up as soon as the
+             * payload is no smaller than the raw chunk.
+             */
+            template<typename T>
+            class ZeroRunEncoder {
+                std::vector<char> &out;
+                size_t limit;
+                uint32_t zeros;
+                uint32_t literals;
+                size_t record;
+                bool open;
+
+                void append(const void *bytes, size_t n) {
+                    const char *begin = (const char *) bytes;
+                    out.insert(out.end(), begin, begin + n);
+                }
+
+                void closeRecord() {
+                    if (open) {
+                        memcpy(&out[record + sizeof(uint32_t)], &literals,
+                               sizeof(uint32_t));
+                        open = false;
+                    }
+                }
+
+            public:
+                ZeroRunEncoder(std::vector<char> &out_t, size_t limit_t)
+                        : out(out_t), limit(limit_t), zeros(0), literals(0),
+                          record(0), open(false) {
+                    out.clear();
+                }
+
+                bool add(const T *x, size_t n) {
+                    for (size_t i = 0; i < n; i++) {
+                        if (isZero(x[i])) {
+                            closeRecord();
+                            zeros++;
+                            continue;
+                        }
+                        if (!open) {
+                            record = out.size();
+                            uint32_t counts[2] = {zeros, 0};
+                            append(counts, sizeof(counts));
+                            zeros = 0;
+                            literals = 0;
+                            open = true;
+                        }
+                        append(&x[i], sizeof(T));
+                        literals++;
+                    }
+                    return out.size() < limit;
+                }
+
+                bool finish() {
+                    closeRecord();
+                    if (zeros > 0) {
+                        uint32_t counts[2] = {zeros, 0};
+                        append(counts, sizeof(counts));
+                        zeros = 0;
+                    }
+                    return out.size() < limit;
+                }
+            };
+
+            template<typename T, typename Rows>
+            void writeChunks(std::ostream &os, Rows row, size_t rows,
+                             size_t cols, Encoding encoding,
+                             size_t chunkElements) {
+                size_t total = rows * cols;
+                std::vector<char> encoded;
+                for (size_t first = 0; first < total; first += chunkElements) {
+                    size_t count = std::min(chunkElements, total - first);
+                    size_t rawBytes = count * sizeof(T);
+
+                    bool useZeroRun = false;
+                    if (encoding == ZERO_RUN) {
+                        ZeroRunEncoder<T> encoder(encoded, rawBytes);
+                        useZeroRun = true;
+                        forEachSegment(row, cols, first, count,
+                                       [&](const T *x, size_t n) {
+                                           useZeroRun = useZeroRun &&
+                                                        encoder.add(x, n);
+                                       });
+                        useZeroRun = useZeroRun && encoder.finish();
+                    }
+
+                    put<uint8_t>(os, useZeroRun ? ZERO_RUN : RAW);
+                    put<uint32_t>(os, (uint32_t) count);
+                    if (useZeroRun) {
+                        put<uint32_t>(os, (uint32_t) encoded.size());
+                        os.write(encoded.data(), encoded.size());
+                        continue;
+                    }
+                    put<uint32_t>(os, (uint32_t) rawBytes);
+                    forEachSegment(row, cols, first, count,
+                                   [&os](const T *x, size_t n) {
+                                       os.write((const char *) x,
+                                                n * sizeof(T));
+                                   });
+                }
+            }
+
+            template<typename T, typename Rows>
+            void decodeZeroRun(const std::vector<char> &payload, Rows row,
+                               size_t cols, size_t first, size_t count) {
+                size_t at = 0;
+                size_t filled = 0;
+                while (at < payload.size()) {
+                    uint32_t counts[2];
+                    if (payload.size() - at < sizeof(counts)) {
+                        throw MtmExceptions::MalformedStream();
+                    }
+                    memcpy(counts, &payload[at], sizeof(counts));
+                    at += sizeof(counts);
+                    size_t zeros = counts[0];
+                    size_t literals = counts[1];
+                    if (zeros > count - filled ||
+                        literals > count - filled - zeros ||
+                        literals * sizeof(T) > payload.size() - at) {
+                        throw MtmExceptions::MalformedStream();
+                    }
+                    forEachSegment(row, cols, first + filled, zeros,
+                                   [](T *x, size_t n) {
+                                       std::fill(x, x + n, T());
+                                   });
+                    filled += zeros;
+                    forEachSegment(row, cols, first + filled, literals,
+                                   [&](T *x, size_t n) {
+                                       memcpy((void *) x, &payload[at],
+                                              n * sizeof(T));
+                                       at += n * sizeof(T);
+                                   });
+                    filled += literals;
+                }
+                if (filled != count) {
+                    throw MtmExceptions::MalformedStream();
+                }
+            }
+
+            /*
+             * Reads the chunks into rows x cols storage and calls
+             * onChunk(first, last) after elements [first, last) are filled
+             */
+            template<typename T, typename Rows, typename F>
+            void readChunks(std::istream &is, const Header &header, Rows row,
+                            size_t cols, F onChunk) {
+                size_t total = (size_t) (header.rows * header.cols);
+                std::vector<char> payload;
+                for (size_t first = 0; first < total;) {
+                    uint8_t encoding = get<uint8_t>(is);
+                    size_t count = get<uint32_t>(is);
+                    size_t bytes = get<uint32_t>(is);
+                    if (count == 0 || count > header.chunkElements ||
+                        count > total - first) {
+                        throw MtmExceptions::MalformedStream();
+                    }
+
+                    if (encoding == RAW) {
+                        if (bytes != count * sizeof(T)) {
+                            throw MtmExceptions::MalformedStream();
+                        }
+                        forEachSegment(row, cols, first, count,
+                                       [&is](T *x, size_t n) {
+                                           if (!is.read((char *) x,
+                                                        n * sizeof(T))) {
+                                               throw MtmExceptions::
+                                               MalformedStream();
+                                           }
+                                       });
+                    } else if (encoding == ZERO_RUN &&
+                               bytes < count * sizeof(T)) {
+                        payload.resize(bytes);
+                        if (!is.read(payload.data(), bytes)) {
+                            throw MtmExceptions::MalformedStream();
+                        }
+                        decodeZeroRun<T>(payload, row, cols, first, count);
+                    } else {
+                        throw MtmExceptions::MalformedStream();
+                    }
+
+                    onChunk(first, first + count);
+                    first += count;
+                }
+            }
+
+            /*
+             * Element types that can be moved as raw bytes. Complex only
+             * holds two doubles but its user defined assignment hides that
+             * from is_trivially_copyable.
+             */
+            template<typename T>
+            struct IsBitwise : std::is_trivially_copyable<T> {
+            };
+
+            template<>
+            struct IsBitwise<Complex> : std::true_type {
+            };
+
+            template<typename T>
+            void checkElement() {
+                static_assert(IsBitwise<T>::value,
+                              "MtmStream needs trivially copyable elements");
+            }
+        }
+
+        //WRITING
+
+        template<typename T>
+        void write(std::ostream &os, const MtmVec<T> &v,
+                   Encoding encoding = RAW,
+                   size_t chunkElements = DEFAULT_CHUNK_ELEMENTS) {
+            MtmStreamOps::checkElement<T>();
+            if (chunkElements == 0 || chunkElements > UINT32_MAX / sizeof(T)) {
+                throw MtmExceptions::IllegalInitialization();
+            }
+            MtmStreamOps::Header header;
+            header.kind = MtmStreamOps::KIND_VECTOR;
+            header.elementSize = sizeof(T);
+            header.rows = (uint64_t) v.getDimensions().getRow();
+            header.cols = (uint64_t) v.getDimensions().getCol();
+            header.chunkElements = (uint32_t) chunkElements;
+            MtmStreamOps::writeHeader(os, header);
+            MtmStreamOps::writeChunks<T>(
+                    os, MtmKernels::ContiguousRows<const T>(v.data(),
+                                                             v.size()),
+                    1, v.size(), encoding, chunkElements);
+        }
+
+        template<typename T>
+        void write(std::ostream &os, const MtmMat<T> &mat,
+                   Encoding encoding = RAW,
+                   size_t chunkElements = DEFAULT_CHUNK_ELEMENTS) {
+            MtmStreamOps::checkElement<T>();
+            if (chunkElements == 0 || chunkElements > UINT32_MAX / sizeof(T)) {
+                throw MtmExceptions::IllegalInitialization();
+            }
+            size_t rows = (size_t) mat.getDimensions().getRow();
+            size_t cols = (size_t) mat.getDimensions().getCol();
+            MtmStreamOps::Header header;
+            header.kind = MtmStreamOps::KIND_MATRIX;
+            header.elementSize = sizeof(T);
+            header.rows = rows;
+            header.cols = cols;
+            header.chunkElements = (uint32_t) chunkElements;
+            MtmStreamOps::writeHeader(os, header);
+            MtmStreamOps::writeChunks<T>(
+                    os, MtmKernels::MatRows<const MtmMat<T>, const T>(mat),
+                    rows, cols, encoding, chunkElements);
+        }
+
+        //READING
+
+        /*
+         * Reads a vector written by write(). onReady(first, last, v) is
+         * called whenever elements [first, last) have arrived.
+         */
+        template<typename T, typename F>
+        MtmVec<T> readVec(std::istream &is, F onReady) {
+            MtmStreamOps::checkElement<T>();
+            MtmStreamOps::Header header = MtmStreamOps::readHeader(
+                    is, MtmStreamOps::KIND_VECTOR, sizeof(T));
+            if (header.rows != 1 && header.cols != 1) {
+                throw MtmExceptions::MalformedStream();
+            }
+            size_t n = (size_t) (header.rows * header.cols);
+            MtmVec<T> result(n, T());
+            if (header.rows == 1 && header.cols != 1) {
+                result.transpose();
+            }
+            MtmStreamOps::readChunks<T>(
+                    is, header, MtmKernels::ContiguousRows<T>(result.data(), n),
+                    n, [&](size_t first, size_t last) {
+                        onReady(first, last, (const MtmVec<T> &) result);
+                    });
+            return result;
+        }
+
+        template<typename T>
+        MtmVec<T> readVec(std::istream &is) {
+            return readVec<T>(is, [](size_t, size_t, const MtmVec<T> &) {});
+        }
+
+        /*
+         * Reads a matrix written by write(). onReady(first, last, mat) is
+         * called whenever rows [first, last) have arrived, the rows after
+         * them are still being filled.
+         */
+        template<typename T, typename F>
+        MtmMat<T> readMat(std::istream &is, F onReady) {
+            MtmStreamOps::checkElement<T>();
+            MtmStreamOps::Header header = MtmStreamOps::readHeader(
+                    is, MtmStreamOps::KIND_MATRIX, sizeof(T));
+            MtmMat<T> result(Dimensions((size_t) header.rows,
+                                        (size_t) header.cols), T());
+            size_t cols = (size_t) header.cols;
+            size_t readyRows = 0;
+            MtmStreamOps::readChunks<T>(
+                    is, header, MtmKernels::MatRows<MtmMat<T>, T>(result),
+                    cols, [&](size_t, size_t last) {
+                        if (last / cols > readyRows) {
+                            onReady(readyRows, last / cols,
+                                    (const MtmMat<T> &) result);
+                            readyRows = last / cols;
+                        }
+                    });
+            return result;
+        }
+
+        template<typename T>
+        MtmMat<T> readMat(std::istream &is) {
+            return readMat<T>(is, [](size_t, size_t, const MtmMat<T> &) {});
+        }
+
+    }
+}
+
+#endif //EX3_MTMSTREAM_H
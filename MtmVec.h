@@ -3,9 +3,15 @@
 
 #include <vector>
 #include <iterator>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #include "MtmExceptions.h"
 #include "Auxilaries.h"
 #include "Complex.h"
+#include "MtmStats.h"
+#include "MtmCpu.h"
+#include "MtmSmallVec.h"
 #include "cmath"
 
 
@@ -15,58 +21,125 @@ namespace MtmMath {
 
     //VECTOR ITERATOR CLASS
 
+    /*
+     * Contiguous random access iterator over the vector storage, T is const
+     * for the const_iterator. Behaves like a plain pointer so std algorithms
+     * (including the parallel ones) get full speed.
+     */
     template<typename T>
-    class VecIterator
-            : public std::iterator<std::random_access_iterator_tag, T> {
+    class VecIterator {
 
         T *dataPtr;
 
+        template<typename S>
+        friend class VecIterator;
+
     public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef typename std::remove_const<T>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T *pointer;
+        typedef T &reference;
+
         VecIterator(T *ptr = NULL) : dataPtr(ptr) {}
 
-        VecIterator(const VecIterator &toCopy) : dataPtr(toCopy.dataPtr) {}
+        VecIterator(const VecIterator &toCopy) = default;
 
-        virtual ~VecIterator() = default;
+        //iterator -> const_iterator
+        template<typename S, typename = typename std::enable_if<
+                std::is_same<const S, T>::value>::type>
+        VecIterator(const VecIterator<S> &toConvert)
+                : dataPtr(toConvert.dataPtr) {}
 
-        bool operator==(const VecIterator &toCompare) const;
+        ~VecIterator() = default;
 
-        bool operator!=(const VecIterator &toCompare) const;
+        VecIterator &operator=(const VecIterator &c) = default;
 
-        virtual T &operator*();
+        T &operator*() const {
+            return *dataPtr;
+        }
 
-        VecIterator &operator=(const VecIterator &c);
+        T *operator->() const {
+            return dataPtr;
+        }
 
-        VecIterator operator++();
-    };
+        T &operator[](difference_type n) const {
+            return dataPtr[n];
+        }
 
-    template<typename T>
-    VecIterator<T> VecIterator<T>::operator++() {
-        ++dataPtr;
-        return *this;
-    }
+        VecIterator &operator++() {
+            ++dataPtr;
+            return *this;
+        }
 
-    template<typename T>
-    T &VecIterator<T>::operator*() {
-        return (*dataPtr);
-    }
+        VecIterator operator++(int) {
+            VecIterator result = *this;
+            ++dataPtr;
+            return result;
+        }
 
-    template<typename T>
-    bool VecIterator<T>::operator==(const VecIterator &toCompare) const {
-        return (dataPtr == toCompare.dataPtr);
-    }
+        VecIterator &operator--() {
+            --dataPtr;
+            return *this;
+        }
 
-    template<typename T>
-    bool VecIterator<T>::operator!=(const VecIterator &toCompare) const {
-        return (dataPtr != toCompare.dataPtr);
-    }
+        VecIterator operator--(int) {
+            VecIterator result = *this;
+            --dataPtr;
+            return result;
+        }
 
-    template<typename T>
-    VecIterator<T> &VecIterator<T>::operator=(const VecIterator<T> &c) {
-        if (this == &c) {
+        VecIterator &operator+=(difference_type n) {
+            dataPtr += n;
             return *this;
         }
-        dataPtr = c.dataPtr;
-        return *this;
+
+        VecIterator &operator-=(difference_type n) {
+            dataPtr -= n;
+            return *this;
+        }
+
+        VecIterator operator+(difference_type n) const {
+            return VecIterator(dataPtr + n);
+        }
+
+        VecIterator operator-(difference_type n) const {
+            return VecIterator(dataPtr - n);
+        }
+
+        difference_type operator-(const VecIterator &other) const {
+            return dataPtr - other.dataPtr;
+        }
+
+        bool operator==(const VecIterator &toCompare) const {
+            return dataPtr == toCompare.dataPtr;
+        }
+
+        bool operator!=(const VecIterator &toCompare) const {
+            return dataPtr != toCompare.dataPtr;
+        }
+
+        bool operator<(const VecIterator &toCompare) const {
+            return dataPtr < toCompare.dataPtr;
+        }
+
+        bool operator>(const VecIterator &toCompare) const {
+            return dataPtr > toCompare.dataPtr;
+        }
+
+        bool operator<=(const VecIterator &toCompare) const {
+            return dataPtr <= toCompare.dataPtr;
+        }
+
+        bool operator>=(const VecIterator &toCompare) const {
+            return dataPtr >= toCompare.dataPtr;
+        }
+    };
+
+    template<typename T>
+    VecIterator<T> operator+(typename VecIterator<T>::difference_type n,
+                             const VecIterator<T> &it) {
+        return it + n;
     }
 
     //NON ZERO ITERATOR CLASS
@@ -74,13 +147,14 @@ namespace MtmMath {
     template<typename T>
     class VecNonZeroIterator {
         T *NonZeroPtr;
-        int location;
-        int size;
+        index_t location;
+        index_t size;
 
 
     public:
 
-        VecNonZeroIterator(T *ptr = NULL, int size_t = 0, int location = 0) :
+        VecNonZeroIterator(T *ptr = NULL, index_t size_t = 0,
+                           index_t location = 0) :
                 NonZeroPtr(ptr), location(location), size(size_t) {}
 
         VecNonZeroIterator(const VecNonZeroIterator &toCopy) = default;
@@ -137,29 +211,59 @@ namespace MtmMath {
     //VECTOR CLASS
 
     template<typename T>
-    class MtmVec : public std::vector<T> {
+    class MtmVec
+            : public MtmSmallVec<T, MtmSmallVecOps::inlineCapacity<T>()> {
+
+    public:
+        //element storage, inline for short vectors of numbers
+        typedef MtmSmallVec<T, MtmSmallVecOps::inlineCapacity<T>()> Storage;
 
     protected:
         Dimensions objectDimensions;
 
 
     public:
+        /*
+         * Per element write permissions, empty while every element is
+         * allowed - the usual case - so it takes no heap block and a
+         * short vector lives entirely inside the object. Only restricted
+         * vectors (triangular rows) fill it in.
+         * Go through isAllowed / forbid rather than indexing it.
+         */
         std::vector<bool> permissions;
 
         typedef VecIterator<T> iterator;
+        typedef VecIterator<const T> const_iterator;
         typedef VecNonZeroIterator<T> nonzero_iterator;
 
         virtual void allowAllVec();
 
+        bool allAllowed() const {
+            return permissions.empty();
+        }
+
+        bool isAllowed(size_t index) const {
+            return permissions.empty() || permissions[index];
+        }
+
+        /*
+         * Forbids writing element index through operator[]
+         */
+        void forbid(size_t index) {
+            if (permissions.empty()) {
+                permissions.assign(this->size(), true);
+            }
+            permissions[index] = false;
+        }
+
         /*
          * Vector constructor, m is the number of elements in it and val is the
          * initial value for the matrix elements
          */
         //Constructors declarations
 
-        MtmVec(size_t m, const T &val = T()) try : std::vector<T>(m, val),
-                                                   objectDimensions(m, 1),
-                                                   permissions(m, true) {
+        MtmVec(size_t m, const T &val = T()) try : Storage(m, val),
+                                                   objectDimensions(m, 1) {
             if (m <= 0) {
                 throw MtmExceptions::IllegalInitialization();
             }
@@ -168,6 +272,7 @@ namespace MtmMath {
                 //errors aren't happening on my pc unless it's a super high num
                 throw MtmExceptions::OutOfMemory();
             }
+            MTM_STATS_ALLOCATE(m * sizeof(T));
         }
         catch (std::bad_alloc &e) {
             throw MtmMath::MtmExceptions::OutOfMemory();
@@ -175,69 +280,89 @@ namespace MtmMath {
 
         MtmVec() = default;
 
-        MtmVec(const MtmVec &toCopy) = default;
+        MtmVec(const MtmVec &toCopy) : Storage(toCopy),
+                                       objectDimensions(
+                                               toCopy.objectDimensions),
+                                       permissions(toCopy.permissions) {
+            MTM_STATS_ALLOCATE(this->size() * sizeof(T));
+            MTM_STATS_COPY(this->size() * sizeof(T));
+        }
+
+        //move constructor, takes over the storage and leaves toMove empty
+        MtmVec(MtmVec &&toMove) noexcept : Storage(std::move(toMove)),
+                                           objectDimensions(
+                                                   toMove.objectDimensions),
+                                           permissions(std::move(
+                                                   toMove.permissions)) {
+            toMove.objectDimensions = Dimensions();
+        }
 
         //destructor
-        virtual ~MtmVec() = default;
+        virtual ~MtmVec() {
+            MTM_STATS_RELEASE(this->size() * sizeof(T));
+        }
 
         //operators declarations
         MtmVec &operator=(const MtmVec &c);
 
-        MtmVec operator+=(const MtmVec &c);
+        MtmVec &operator=(MtmVec &&c) noexcept;
 
-        MtmVec operator-=(const MtmVec &c);
+        MtmVec &operator+=(const MtmVec &c);
+
+        MtmVec &operator-=(const MtmVec &c);
 
         MtmVec operator-() const;
 
-        MtmVec operator+=(const T &c);
+        MtmVec &operator+=(const T &c);
 
-        MtmVec operator-=(const T &c);
+        MtmVec &operator-=(const T &c);
 
-        MtmVec operator*=(const T &c);
+        MtmVec &operator*=(const T &c);
 
-        MtmVec operator*=(const MtmVec &c);
+        MtmVec &operator*=(const MtmVec &c);
 
 
 
-        // T& operator[](int index);
+        // T& operator[](index_t index);
 
         bool operator==(const MtmVec &c) const;
 
         bool operator!=(const MtmVec &c) const;
 
-        T &operator[](int index) {
+        T &operator[](index_t index) {
 
-            if (index >= (int) (this->size()) || index < 0) {
+            if (index >= (index_t) (this->size()) || index < 0) {
                 throw MtmExceptions::AccessIllegalElement();
             }
 
-            if (!(this->permissions[index])) {
+            if (!isAllowed((size_t) index)) {
                 throw MtmExceptions::AccessIllegalElement();
             }
 
-            return std::vector<T>::operator[](index);
+            return Storage::operator[](index);
         }
 
-        const T &operator[](int index) const {
-            if (index >= (int) this->size()) {
+        const T &operator[](index_t index) const {
+            if (index >= (index_t) this->size()) {
                 throw MtmExceptions::AccessIllegalElement();
             }
 
-            return std::vector<T>::operator[](index);
+            return Storage::operator[](index);
         }
 
 
         nonzero_iterator nzend() {
             nonzero_iterator result = nonzero_iterator(
-                    &(*this)[this->size() - 1], (int) this->size(),
-                    (int) this->size() - 1);
+                    &(*this)[this->size() - 1], (index_t) this->size(),
+                    (index_t) this->size() - 1);
             return ++result;
         }
 
         nonzero_iterator nzbegin() {
-            for (int i = 0; i < (int) this->size(); i++) {
+            for (index_t i = 0; i < (index_t) this->size(); i++) {
                 if ((*this)[i] != 0) {
-                    return nonzero_iterator(&(*this)[i], (int) this->size(), 0);
+                    return nonzero_iterator(&(*this)[i],
+                                            (index_t) this->size(), 0);
                 }
             }
 
@@ -245,12 +370,27 @@ namespace MtmMath {
         }
 
         iterator end() {
-            iterator result = iterator(&(*this)[this->size() - 1]);
-            return ++result;
+            return iterator(this->data() + this->size());
         }
 
         iterator begin() {
-            return iterator(&((*this)[0]));
+            return iterator(this->data());
+        }
+
+        const_iterator end() const {
+            return const_iterator(this->data() + this->size());
+        }
+
+        const_iterator begin() const {
+            return const_iterator(this->data());
+        }
+
+        const_iterator cend() const {
+            return end();
+        }
+
+        const_iterator cbegin() const {
+            return begin();
         }
 
         /*
@@ -266,6 +406,26 @@ namespace MtmMath {
          */
         virtual void resize(Dimensions dim, const T &val);
 
+        /*
+         * Adds val as the new last element, amortized O(1)
+         */
+        void append(const T &val) try {
+            Storage::push_back(val);
+            if (!permissions.empty()) {
+                permissions.push_back(true);
+            }
+            MTM_STATS_ALLOCATE(sizeof(T));
+            if (objectDimensions.getRow() == 1 &&
+                objectDimensions.getCol() != 1) {
+                objectDimensions = Dimensions(1, this->size());
+            } else {
+                objectDimensions = Dimensions(this->size(), 1);
+            }
+        }
+        catch (std::bad_alloc &e) {
+            throw MtmMath::MtmExceptions::OutOfMemory();
+        }
+
         /*
          * Performs transpose operation on matrix
          */
@@ -280,15 +440,23 @@ namespace MtmMath {
     void MtmVec<T>::resize(Dimensions dim, const T &val) try {
 
         if (objectDimensions.getRow() == 1 && dim.getRow() == 1) {
-            std::vector<T>::resize((size_t) dim.getCol(), val);
-            permissions.resize((size_t) dim.getCol(), true);
+            MTM_STATS_RELEASE(this->size() * sizeof(T));
+            Storage::resize((size_t) dim.getCol(), val);
+            MTM_STATS_ALLOCATE(this->size() * sizeof(T));
+            if (!permissions.empty()) {
+                permissions.resize((size_t) dim.getCol(), true);
+            }
             objectDimensions = dim;
             return;
         }
 
         if (objectDimensions.getCol() == 1 && dim.getCol() == 1) {
-            std::vector<T>::resize((size_t) dim.getRow(), val);
-            permissions.resize(dim.getRow(), true);
+            MTM_STATS_RELEASE(this->size() * sizeof(T));
+            Storage::resize((size_t) dim.getRow(), val);
+            MTM_STATS_ALLOCATE(this->size() * sizeof(T));
+            if (!permissions.empty()) {
+                permissions.resize((size_t) dim.getRow(), true);
+            }
             objectDimensions = dim;
             return;
         }
@@ -392,20 +560,40 @@ namespace MtmMath {
             return *this;
         }
 
+        MTM_STATS_RELEASE(this->size() * sizeof(T));
+        MTM_STATS_ALLOCATE(c.size() * sizeof(T));
+        MTM_STATS_COPY(c.size() * sizeof(T));
+
         objectDimensions = c.objectDimensions;
         permissions = c.permissions;
-        std::vector<T>::operator=(c);
+        Storage::operator=(c);
+        return *this;
+    }
+
+    template<typename T>
+    MtmVec<T> &MtmVec<T>::operator=(MtmVec &&c) noexcept {
+        if (this == &c) {
+            return *this;
+        }
+
+        MTM_STATS_RELEASE(this->size() * sizeof(T));
+
+        objectDimensions = c.objectDimensions;
+        permissions = std::move(c.permissions);
+        Storage::operator=(std::move(c));
+        c.objectDimensions = Dimensions();
         return *this;
     }
 
     template<typename T>
     MtmVec<T> MtmVec<T>::operator-() const {
+        MTM_STATS_OPERATION(VEC_NEGATE, this->size());
         MtmVec<T> result = MtmVec<T>(*this);
         result.allowAllVec();
-        for (int i = 0; i < (int) this->size(); i++) {
+        for (index_t i = 0; i < (index_t) this->size(); i++) {
             result[i] = (-1) * (*this)[i];
         }
-        return MtmVec<T>(result);
+        return result;
     }
 
     template<typename T>
@@ -413,7 +601,7 @@ namespace MtmMath {
         if (this->objectDimensions != c.objectDimensions) {
             return false;
         }
-        for (int i = 0; i < (int) (this->size()); i++) {
+        for (index_t i = 0; i < (index_t) (this->size()); i++) {
             if ((*this)[i] != c[i]) {
                 return false;
             }
@@ -426,7 +614,7 @@ namespace MtmMath {
     template<typename T>
     template<typename Func>
     T MtmVec<T>::vecFunc(Func &f) const {
-        for (int i = 0; i < (int) this->size(); i++) {
+        for (index_t i = 0; i < (index_t) this->size(); i++) {
             f((*this)[i]);
         }
 
@@ -440,25 +628,27 @@ namespace MtmMath {
     }
 
     template<typename T>
-    MtmVec<T> MtmVec<T>::operator-=(const MtmVec<T> &c) {
+    MtmVec<T> &MtmVec<T>::operator-=(const MtmVec<T> &c) {
         return this->operator+=(-c);
     }
 
     template<typename T>
-    MtmVec<T> MtmVec<T>::operator+=(const MtmVec<T> &c) {
+    MtmVec<T> &MtmVec<T>::operator+=(const MtmVec<T> &c) {
         if (this->objectDimensions != c.getDimensions()) {
             throw MtmExceptions::DimensionMismatch(this->getDimensions(),
                                                    c.getDimensions());
         }
-
-        MtmVec<T> result = MtmVec<T>(*this);
-        result.allowAllVec();
-
-        for (int i = 0; i < (int) this->size(); i++) {
-            result[i] += c[i];
-        }
-
-        *this = result;
+        MTM_STATS_OPERATION(VEC_ADD, this->size());
+
+        T *out = this->data();
+        const T *in = c.data();
+        size_t n = this->size();
+        MtmCpu::dispatchFor<T>([out, in, n] {
+            for (size_t i = 0; i < n; i++) {
+                out[i] += in[i];
+            }
+        });
+        allowAllVec();
         return *this;
     }
 
@@ -470,49 +660,60 @@ namespace MtmMath {
 
     template<typename T>
     void MtmVec<T>::allowAllVec() {
-        for (int i = 0; i < (int) ((*this).size()); i++) {
-            permissions[i] = true;
+        MTM_STATS_OPERATION(VEC_ALLOW_ALL, 0);
+        if (!permissions.empty()) {
+            std::vector<bool>().swap(permissions);
         }
     }
 
     template<typename T>
-    MtmVec<T> MtmVec<T>::operator*=(const T &c) {
-        MtmVec<T> result = MtmVec<T>(*this);
-        result.allowAllVec();
-        for (int i = 0; i < (int) this->size(); i++) {
-            result[i] *= c;
-        }
-
-        (*this) = result;
+    MtmVec<T> &MtmVec<T>::operator*=(const T &c) {
+        MTM_STATS_OPERATION(VEC_SCALE, this->size());
+        //c may be one of the elements
+        const T value = c;
+        T *out = this->data();
+        size_t n = this->size();
+        MtmCpu::dispatchFor<T>([out, n, value] {
+            for (size_t i = 0; i < n; i++) {
+                out[i] *= value;
+            }
+        });
+        allowAllVec();
         return *this;
     }
 
     template<typename T>
-    MtmVec<T> MtmVec<T>::operator+=(const T &c) {
-        MtmVec<T> result = MtmVec<T>(*this);
-        result.allowAllVec();
-        for (int i = 0; i < (int) (this->size()); i++) {
-            result[i] += c;
-        }
-        (*this) = result;
+    MtmVec<T> &MtmVec<T>::operator+=(const T &c) {
+        MTM_STATS_OPERATION(VEC_SCALAR_ADD, this->size());
+        //c may be one of the elements
+        const T value = c;
+        T *out = this->data();
+        size_t n = this->size();
+        MtmCpu::dispatchFor<T>([out, n, value] {
+            for (size_t i = 0; i < n; i++) {
+                out[i] += value;
+            }
+        });
+        allowAllVec();
         return *this;
     }
 
     template<typename T>
-    MtmVec<T> MtmVec<T>::operator-=(const T &c) {
+    MtmVec<T> &MtmVec<T>::operator-=(const T &c) {
         return operator+=(-(c));
     }
 
     template<typename T>
-    MtmVec<T> MtmVec<T>::operator*=(const MtmVec<T> &c) {
+    MtmVec<T> &MtmVec<T>::operator*=(const MtmVec<T> &c) {
         if (this->getDimensions().getCol() != c.getDimensions().getRow()) {
             throw (MtmExceptions::DimensionMismatch(this->getDimensions(),
                                                     c.getDimensions()));
         }
+        MTM_STATS_OPERATION(VEC_DOT, 2 * this->size());
 
         MtmVec<T> result = MtmVec<T>(1, T());
         result[0] = (*this)[0] * c[0];
-        for (int i = 1; i < this->getDimensions().getCol(); i++) {
+        for (index_t i = 1; i < this->getDimensions().getCol(); i++) {
             result[0] += ((*this)[i] * c[i]);
         }
 